@@ -0,0 +1,39 @@
+#pragma once
+
+#include "uxs/common.h"
+
+namespace uxs {
+namespace db {
+namespace detail {
+
+// Block scanners for lexers: process 16 or 32 bytes per step using SSE2/AVX2 (selected at run time) where
+// available, and fall back to byte-by-byte scanning otherwise. Where a scanner corresponds to a `char_tbl_t` flag,
+// its character set matches the flag exactly.
+
+// Skips a run of JSON whitespaces (`is_json_ws`) and adds the number of skipped `\n` characters to `n_lines`
+UXS_EXPORT const char* skip_json_ws(const char* first, const char* last, unsigned& n_lines) noexcept;
+
+// Finds the first `is_string_special` character: `\0`, `\n`, `"` or `\\`
+UXS_EXPORT const char* find_json_string_special(const char* first, const char* last) noexcept;
+
+// Finds the first of `"`, `/`, `[`, `]`, `{`, `}` or `\0` characters and adds the number of skipped `\n` characters
+// to `n_lines`
+UXS_EXPORT const char* find_json_structural(const char* first, const char* last, unsigned& n_lines) noexcept;
+
+// Finds the first character to be escaped in JSON string: `"`, `\\` or a control character (below 0x20)
+UXS_EXPORT const char* find_json_escape(const char* first, const char* last) noexcept;
+
+// Finds the first `is_xml_special` character: `\0`, `&` or `<`, and adds the number of skipped `\n` characters to
+// `n_lines`
+UXS_EXPORT const char* find_xml_special(const char* first, const char* last, unsigned& n_lines) noexcept;
+
+// Finds the first `is_xml_string_special` character of a string quoted with `quot`: `\0`, `\n`, `&`, `<` or `quot`
+// itself, the other quotation mark is skipped
+UXS_EXPORT const char* find_xml_string_special(const char* first, const char* last, char quot) noexcept;
+
+// Finds the first character to be escaped in XML text: `&`, `<`, `>`, `'` or `"`
+UXS_EXPORT const char* find_xml_escape(const char* first, const char* last) noexcept;
+
+}  // namespace detail
+}  // namespace db
+}  // namespace uxs
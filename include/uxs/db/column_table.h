@@ -0,0 +1,142 @@
+#pragma once
+
+#include "value.h"
+
+#include <string>
+#include <vector>
+
+namespace uxs {
+namespace db {
+
+// Column table is a columnar image of an array of records: there is a column per key in order of first occurrence,
+// and each column keeps its cells in a typed array, so single field scans and aggregations run over contiguous data.
+// Integral values go to `integer` columns, mixed integral and floating-point values to `double_precision` columns,
+// which also keep exact integral values, and columns with values of other or several types keep them as is. Missing
+// fields and nulls are invalid cells, which are zero in typed arrays; missing fields are also absent cells, which are
+// left out of restored records, so records are restored as they were, except that their items go in column order.
+
+enum class column_type : std::uint8_t {
+    null = 0,
+    boolean,
+    integer,
+    double_precision,
+    string,
+    value,
+};
+
+class column {
+ public:
+    const std::string& name() const noexcept { return name_; }
+    column_type type() const noexcept { return type_; }
+    std::size_t size() const noexcept { return size_; }
+
+    // Validity bitmap: a bit per row, starting from low bits of the first word
+    est::span<const std::uint64_t> validity() const noexcept { return est::as_span(validity_); }
+    bool is_valid(std::size_t row) const noexcept { return (validity_[row >> 6] >> (row & 63)) & 1; }
+    UXS_EXPORT std::size_t valid_count() const noexcept;
+
+    // Presence bitmap: a bit per row having the field, which can be null
+    est::span<const std::uint64_t> presence() const noexcept { return est::as_span(presence_); }
+    bool is_present(std::size_t row) const noexcept { return (presence_[row >> 6] >> (row & 63)) & 1; }
+
+    // Integral bitmap of `double_precision` columns: a bit per row with integral value, which is also kept exactly
+    // in `int64_data()`; empty if the column has no integral values
+    est::span<const std::uint64_t> integral() const noexcept { return est::as_span(integral_); }
+    bool is_integral(std::size_t row) const noexcept {
+        return !integral_.empty() && ((integral_[row >> 6] >> (row & 63)) & 1);
+    }
+
+    est::span<const std::uint8_t> bool_data() const noexcept { return est::as_span(bools_); }
+    est::span<const std::int64_t> int64_data() const noexcept { return est::as_span(ints_); }
+    est::span<const double> double_data() const noexcept { return est::as_span(doubles_); }
+
+    // Characters of string `i` are in [`string_offsets()[i]`, `string_offsets()[i + 1]`) of `string_chars()`
+    est::span<const std::uint64_t> string_offsets() const noexcept { return est::as_span(offsets_); }
+    std::string_view string_chars() const noexcept { return chars_; }
+    std::string_view string_at(std::size_t row) const noexcept {
+        return std::string_view(chars_.data() + offsets_[row],
+                                static_cast<std::size_t>(offsets_[row + 1] - offsets_[row]));
+    }
+
+    UXS_EXPORT basic_value<char> operator[](std::size_t row) const;
+
+ private:
+    friend class column_table;
+
+    std::string name_;
+    column_type type_ = column_type::null;
+    std::size_t size_ = 0;
+    std::vector<std::uint64_t> validity_;
+    std::vector<std::uint64_t> presence_;
+    std::vector<std::uint64_t> integral_;
+    std::vector<std::uint8_t> bools_;
+    std::vector<std::int64_t> ints_;
+    std::vector<double> doubles_;
+    std::vector<std::uint64_t> offsets_;
+    std::string chars_;
+    std::vector<basic_value<char>> values_;
+};
+
+class column_table;
+
+// Record-like view of a table row: positional access goes over all columns, and `find` and `to_value` skip fields
+// missing in the row
+class row_view {
+ public:
+    row_view(const column_table& table, std::size_t row) noexcept : table_(&table), row_(row) {}
+
+    std::size_t row() const noexcept { return row_; }
+    inline std::size_t size() const noexcept;
+    bool empty() const noexcept { return size() == 0; }
+
+    inline std::string_view key(std::size_t i) const;
+    inline basic_value<char> operator[](std::size_t i) const;
+
+    UXS_EXPORT est::optional<basic_value<char>> find(std::string_view key) const;
+    bool contains(std::string_view key) const { return !!find(key); }
+    basic_value<char> operator[](std::string_view key) const { return at(key); }
+    basic_value<char> at(std::string_view key) const {
+        if (auto v = find(key)) { return std::move(*v); }
+        throw database_error("invalid key");
+    }
+    basic_value<char> value(std::string_view key) const {
+        auto v = find(key);
+        return v ? std::move(*v) : basic_value<char>();
+    }
+
+    UXS_EXPORT basic_value<char> to_value() const;
+
+ private:
+    const column_table* table_;
+    std::size_t row_;
+};
+
+class column_table {
+ public:
+    column_table() noexcept = default;
+
+    // Makes the table of an array of records
+    UXS_EXPORT static column_table from_value(const basic_value<char>& v);
+
+    std::size_t row_count() const noexcept { return row_count_; }
+    std::size_t column_count() const noexcept { return columns_.size(); }
+    const column& col(std::size_t i) const noexcept { return columns_[i]; }
+    UXS_EXPORT const column* find(std::string_view name) const noexcept;
+
+    row_view row(std::size_t i) const noexcept { return row_view(*this, i); }
+    row_view operator[](std::size_t i) const noexcept { return row(i); }
+
+    UXS_EXPORT basic_value<char> to_value() const;
+
+ private:
+    std::size_t row_count_ = 0;
+    std::vector<column> columns_;
+    std::vector<std::size_t> sorted_;  // column indices sorted by name
+};
+
+std::size_t row_view::size() const noexcept { return table_->column_count(); }
+std::string_view row_view::key(std::size_t i) const { return table_->col(i).name(); }
+basic_value<char> row_view::operator[](std::size_t i) const { return table_->col(i)[row_]; }
+
+}  // namespace db
+}  // namespace uxs
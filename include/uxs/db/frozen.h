@@ -0,0 +1,146 @@
+#pragma once
+
+#include "value.h"
+
+#include "uxs/io/iobuf.h"
+
+#include <vector>
+
+namespace uxs {
+namespace db {
+
+// Frozen format is a read-only binary image of `basic_value<char>`, which can be used in place, e.g. directly from
+// a memory-mapped file (map it entirely with `mappedfile` window size not less than file size). All data is 8-byte
+// aligned and in native byte order:
+//   header       : magic (8 bytes), byte order mark (8 bytes), image size (8 bytes)
+//   nodes        : strings, arrays and records; children precede their parents
+//   root slot    : 16 bytes
+// A slot holds a scalar value or an offset of the node: string - length, characters and terminating zero; array -
+// element count and element slots; record - entry count, entries sorted by key hash (key hash, key string offset
+// and value slot), and positions of entries in the original order. Opening an image checks its header and root
+// node in constant time, so a truncated image is rejected; checked opening also checks all nodes, so an untrusted
+// image with damaged nodes is rejected instead of being read out of bounds.
+
+namespace detail {
+struct frozen_slot_t {
+    std::uint64_t data;
+    std::uint8_t type;
+    std::uint8_t reserved[7];
+};
+
+struct frozen_entry_t {
+    std::uint64_t hash;
+    std::uint64_t key;
+    frozen_slot_t value;
+};
+
+UXS_EXPORT std::uint64_t frozen_key_hash(std::string_view key) noexcept;
+
+class frozen_writer {
+ public:
+    static const std::size_t header_size = 24;
+
+    static std::uint64_t string_size(std::size_t len) noexcept { return sizeof(std::uint64_t) + len + 8 - len % 8; }
+    static std::uint64_t array_size(std::size_t count) noexcept {
+        return sizeof(std::uint64_t) + count * sizeof(frozen_slot_t);
+    }
+    static std::uint64_t record_size(std::size_t count) noexcept {
+        return sizeof(std::uint64_t) + count * (sizeof(frozen_entry_t) + sizeof(std::uint64_t));
+    }
+
+    UXS_EXPORT frozen_writer(biobuf& out, std::uint64_t image_size);
+    UXS_EXPORT std::uint64_t write_string(std::string_view s);
+    UXS_EXPORT std::uint64_t write_array(const std::vector<frozen_entry_t>& elements);
+    UXS_EXPORT std::uint64_t write_record(const std::vector<frozen_entry_t>& entries);
+    UXS_EXPORT void finish(const frozen_slot_t& root);
+
+ private:
+    biobuf& out_;
+    std::uint64_t pos_ = 0;
+    std::uint64_t image_size_;
+
+    void write(const void* data, std::size_t sz);
+};
+}  // namespace detail
+
+class frozen_value {
+ public:
+    frozen_value() noexcept = default;
+
+    // Returns the root value of the frozen image; the image must be kept alive while values are in use
+    UXS_EXPORT static frozen_value open(const void* data, std::size_t sz);
+
+    // The same as `open`, but also checks all nodes of the image, which takes time linear in image size
+    UXS_EXPORT static frozen_value open_checked(const void* data, std::size_t sz);
+
+    dtype type() const noexcept { return type_; }
+
+    bool is_null() const noexcept { return type_ == dtype::null; }
+    bool is_bool() const noexcept { return type_ == dtype::boolean; }
+    bool is_integral() const noexcept { return type_ >= dtype::integer && type_ <= dtype::unsigned_long_integer; }
+    bool is_numeric() const noexcept { return type_ >= dtype::integer && type_ <= dtype::double_precision; }
+    bool is_string() const noexcept { return type_ == dtype::string; }
+    bool is_array() const noexcept { return type_ == dtype::array; }
+    bool is_record() const noexcept { return type_ == dtype::record; }
+
+    UXS_EXPORT bool as_bool() const;
+    UXS_EXPORT std::int64_t as_int64() const;
+    UXS_EXPORT std::uint64_t as_uint64() const;
+    UXS_EXPORT double as_double() const;
+    UXS_EXPORT std::string_view as_string_view() const;
+
+    bool empty() const noexcept { return size() == 0; }
+    std::size_t size() const noexcept {
+        return type_ == dtype::array || type_ == dtype::record ? static_cast<std::size_t>(node_header()) : 0;
+    }
+
+    // Array element or record value in the original order
+    UXS_EXPORT frozen_value operator[](std::size_t i) const;
+    UXS_EXPORT std::string_view key(std::size_t i) const;
+    frozen_value at(std::size_t i) const {
+        if (i < size()) { return (*this)[i]; }
+        throw database_error("index out of range");
+    }
+
+    UXS_EXPORT est::optional<frozen_value> find(std::string_view key) const noexcept;
+    bool contains(std::string_view key) const noexcept { return !!find(key); }
+    frozen_value operator[](std::string_view key) const { return at(key); }
+    frozen_value at(std::string_view key) const {
+        if (const auto v = find(key)) { return *v; }
+        throw database_error("invalid key");
+    }
+    frozen_value value(std::string_view key) const {
+        const auto v = find(key);
+        return v ? *v : frozen_value();
+    }
+
+    UXS_EXPORT basic_value<char> thaw() const;
+
+ private:
+    const std::uint8_t* base_ = nullptr;
+    std::uint64_t data_ = 0;
+    dtype type_ = dtype::null;
+
+    frozen_value(const std::uint8_t* base, const detail::frozen_slot_t& slot) noexcept
+        : base_(base), data_(slot.data), type_(static_cast<dtype>(slot.type)) {}
+
+    std::uint64_t node_header() const noexcept { return *reinterpret_cast<const std::uint64_t*>(base_ + data_); }
+    const detail::frozen_slot_t* array_slots() const noexcept {
+        return reinterpret_cast<const detail::frozen_slot_t*>(base_ + data_ + sizeof(std::uint64_t));
+    }
+    const detail::frozen_entry_t* record_entries() const noexcept {
+        return reinterpret_cast<const detail::frozen_entry_t*>(base_ + data_ + sizeof(std::uint64_t));
+    }
+    std::string_view string_at(std::uint64_t offset) const noexcept {
+        const std::uint64_t sz = *reinterpret_cast<const std::uint64_t*>(base_ + offset);
+        return std::string_view(reinterpret_cast<const char*>(base_ + offset + sizeof(std::uint64_t)),
+                                static_cast<std::size_t>(sz));
+    }
+};
+
+// Writes frozen image of the value
+template<typename Alloc>
+UXS_EXPORT void freeze(biobuf& out, const basic_value<char, Alloc>& v);
+
+}  // namespace db
+}  // namespace uxs
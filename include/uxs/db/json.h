@@ -4,6 +4,7 @@
 
 #include "uxs/io/iflatbuf.h"
 #include "uxs/io/iomembuffer.h"
+#include "uxs/memory.h"
 #include "uxs/string_cvt.h"
 
 namespace uxs {
@@ -11,6 +12,9 @@ namespace db {
 template<typename CharT, typename Alloc>
 class basic_value;
 
+template<typename CharT, typename Alloc>
+class basic_shape_table;
+
 namespace json {
 
 enum class token_t : int {
@@ -36,25 +40,56 @@ struct json_fmt_opts {
 };
 
 namespace detail {
+// Numeric value decoded by the lexer: `u64` for `integer_number`, `i64` for `negative_integer_number`, and `dbl`
+// for `floating_point_number`; integers that don't fit 64 bits are returned as `floating_point_number`
+union number_t {
+    std::uint64_t u64;
+    std::int64_t i64;
+    double dbl;
+};
+
 struct lexer {
     ibuf& in;
+    monotonic_arena* arena;
     unsigned ln = 1;
+    number_t num{};
     inline_dynbuffer str;
     inline_basic_dynbuffer<char, 32> stash;
     inline_basic_dynbuffer<std::int8_t, 32> stack;
-    UXS_EXPORT explicit lexer(ibuf& in);
+    UXS_EXPORT explicit lexer(ibuf& in, monotonic_arena* arena = nullptr);
     UXS_EXPORT token_t lex(std::string_view& lval);
+    UXS_EXPORT void skip_subtree();
 };
+
+template<typename Func, typename = void>
+struct is_number_value_func : std::false_type {};
+template<typename Func>
+struct is_number_value_func<Func, std::void_t<decltype(std::declval<const Func&>()(
+                                      token_t::eof, std::string_view(), std::declval<const number_t&>()))>>
+    : std::true_type {};
+
+// Passes decoded number to value function if it accepts it
+template<typename Func>
+parse_step call_value_func(const Func& fn, token_t tt, std::string_view lval, const number_t& num, std::true_type) {
+    return fn(tt, lval, num);
+}
+template<typename Func>
+parse_step call_value_func(const Func& fn, token_t tt, std::string_view lval, const number_t& /*num*/,
+                           std::false_type) {
+    return fn(tt, lval);
+}
 }  // namespace detail
 
+namespace detail {
 template<typename ValueFunc, typename ArrItemFunc, typename ObjItemFunc, typename PopFunc>
-void read(ibuf& in, const ValueFunc& fn_value, const ArrItemFunc& fn_arr_item, const ObjItemFunc& fn_obj_item,
-          const PopFunc& fn_pop) {
-    detail::lexer lexer(in);
+void parse(lexer& lexer, const ValueFunc& fn_value, const ArrItemFunc& fn_arr_item, const ObjItemFunc& fn_obj_item,
+           const PopFunc& fn_pop) {
     inline_basic_dynbuffer<char, 32> stack;
 
     const auto fn_value_checked = [&lexer, &fn_value](token_t tt, std::string_view lval) -> parse_step {
-        if (tt >= token_t::null_value || tt == token_t('[') || tt == token_t('{')) { return fn_value(tt, lval); }
+        if (tt >= token_t::null_value || tt == token_t('[') || tt == token_t('{')) {
+            return call_value_func(fn_value, tt, lval, lexer.num, is_number_value_func<ValueFunc>{});
+        }
         throw database_error(to_string(lexer.ln) + ": invalid value or unexpected character");
     };
 
@@ -81,6 +116,8 @@ loop:
                     }
                 } else if (ret == parse_step::stop) {
                     return;
+                } else if (tt < token_t::null_value) {
+                    lexer.skip_subtree();
                 }
                 if ((tt = lexer.lex(lval)) == token_t(']')) { break; }
                 if (tt != token_t(',')) { throw database_error(to_string(lexer.ln) + ": expected `,` or `]`"); }
@@ -102,6 +139,8 @@ loop:
                 }
             } else if (ret == parse_step::stop) {
                 return;
+            } else if (tt < token_t::null_value) {
+                lexer.skip_subtree();
             }
             if ((tt = lexer.lex(lval)) == token_t('}')) { break; }
             if (tt != token_t(',')) { throw database_error(to_string(lexer.ln) + ": expected `,` or `}`"); }
@@ -123,10 +162,33 @@ loop:
         }
     }
 }
+}  // namespace detail
+
+template<typename ValueFunc, typename ArrItemFunc, typename ObjItemFunc, typename PopFunc>
+void read(ibuf& in, const ValueFunc& fn_value, const ArrItemFunc& fn_arr_item, const ObjItemFunc& fn_obj_item,
+          const PopFunc& fn_pop) {
+    detail::lexer lexer(in);
+    detail::parse(lexer, fn_value, fn_arr_item, fn_obj_item, fn_pop);
+}
 
+// Strings which can't be referenced in the input buffer as is (containing escape sequences or crossing buffer
+// boundary) are decoded into `arena`, so all string views passed to callbacks remain valid as long as `arena` and
+// the input buffer contents are alive, e.g. for `iflatbuf` or entirely mapped file
+template<typename ValueFunc, typename ArrItemFunc, typename ObjItemFunc, typename PopFunc>
+void read(ibuf& in, const ValueFunc& fn_value, const ArrItemFunc& fn_arr_item, const ObjItemFunc& fn_obj_item,
+          const PopFunc& fn_pop, monotonic_arena& arena) {
+    detail::lexer lexer(in, &arena);
+    detail::parse(lexer, fn_value, fn_arr_item, fn_obj_item, fn_pop);
+}
+
+// Arrays and records are made of exact size when they are read to the end, so they have no spare capacity
 template<typename CharT = char, typename Alloc = std::allocator<CharT>>
 UXS_EXPORT basic_value<CharT, Alloc> read(ibuf& in, const Alloc& al = Alloc());
 
+// Records are made sharing their key sets through `shapes` as soon as they are read
+template<typename CharT, typename Alloc>
+UXS_EXPORT basic_value<CharT, Alloc> read(ibuf& in, basic_shape_table<CharT, Alloc>& shapes, const Alloc& al = Alloc());
+
 template<typename CharT = char, typename Alloc = std::allocator<CharT>>
 basic_value<CharT, Alloc> read_from_string(std::string_view s, const Alloc& al = Alloc()) {
     uxs::iflatbuf in(s);
@@ -153,6 +215,78 @@ void write_formatted(basic_iobuf<CharT>& out, const basic_value<ValueCharT, Allo
     write_formatted(buf, v, opts, indent);
 }
 
+// Writes JSON incrementally without building `basic_value`, checking that calls form a single valid value
+template<typename CharT>
+class basic_writer {
+ public:
+    explicit basic_writer(basic_membuffer<CharT>& out) : out_(out) {}
+    basic_writer(basic_membuffer<CharT>& out, json_fmt_opts opts, unsigned indent = 0)
+        : out_(out), opts_(opts), is_formatted_(true), indent_(indent) {}
+
+    // Output is buffered directly in `out` buffer, so `out` mustn't be used while the writer is alive
+    explicit basic_writer(basic_iobuf<CharT>& out)
+        : iobuf_(est::make_unique<basic_iomembuffer<CharT>>(out)), out_(*iobuf_) {}
+    basic_writer(basic_iobuf<CharT>& out, json_fmt_opts opts, unsigned indent = 0)
+        : iobuf_(est::make_unique<basic_iomembuffer<CharT>>(out)), out_(*iobuf_), opts_(opts), is_formatted_(true),
+          indent_(indent) {}
+
+    bool complete() const noexcept { return is_complete_; }
+    void flush() noexcept {
+        if (iobuf_) { iobuf_->flush(); }
+    }
+
+    UXS_EXPORT basic_writer& begin_array();
+    UXS_EXPORT basic_writer& end_array();
+    UXS_EXPORT basic_writer& begin_object();
+    UXS_EXPORT basic_writer& end_object();
+    UXS_EXPORT basic_writer& key(std::basic_string_view<CharT> k);
+
+    UXS_EXPORT basic_writer& value(std::nullptr_t);
+    UXS_EXPORT basic_writer& value(bool b);
+    UXS_EXPORT basic_writer& value(double f);
+    UXS_EXPORT basic_writer& value(std::basic_string_view<CharT> s);
+    basic_writer& value(const CharT* s) { return value(std::basic_string_view<CharT>(s)); }
+    basic_writer& value(CharT ch) { return value(std::basic_string_view<CharT>(&ch, 1)); }
+    template<typename Ty, typename = std::enable_if_t<std::is_integral<Ty>::value && !std::is_same<Ty, bool>::value &&
+                                                      !is_character<Ty>::value>>
+    basic_writer& value(Ty v) {
+        begin_value();
+        to_basic_string(out_, v);
+        end_value();
+        return *this;
+    }
+    template<typename ValueCharT, typename Alloc>
+    basic_writer& value(const basic_value<ValueCharT, Alloc>& v) {
+        begin_value();
+        if (is_formatted_) {
+            write_formatted(out_, v, opts_, indent_);
+        } else {
+            write(out_, v);
+        }
+        end_value();
+        return *this;
+    }
+
+ private:
+    std::unique_ptr<basic_iomembuffer<CharT>> iobuf_;
+    basic_membuffer<CharT>& out_;
+    json_fmt_opts opts_;
+    bool is_formatted_ = false;
+    bool is_first_element_ = true;
+    bool has_key_ = false;
+    bool is_complete_ = false;
+    unsigned indent_ = 0;
+    inline_basic_dynbuffer<char, 32> stack_;
+
+    UXS_EXPORT void begin_value();
+    void end_value() { is_first_element_ = false, is_complete_ = stack_.empty(); }
+    UXS_EXPORT void write_separator(char ws_char);
+    UXS_EXPORT void end_container(char open_char, char close_char);
+};
+
+using writer = basic_writer<char>;
+using wwriter = basic_writer<wchar_t>;
+
 }  // namespace json
 }  // namespace db
 
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "value.h"
+
+namespace uxs {
+namespace db {
+namespace json {
+
+// JSON Patch (RFC 6902): a patch is an array of operation records with "op", "path", and "value" or "from" items,
+// where paths are JSON Pointers (RFC 6901)
+
+// Makes the patch turning `a` into `b`. Shared copy-on-write subtrees are skipped without comparison, and records
+// are compared regardless of item order. Array elements are matched at common beginning and end, then elements
+// unique on both sides are matched by structural hashes, and the rest are changed in place, added or removed
+template<typename CharT, typename Alloc>
+UXS_EXPORT basic_value<CharT, Alloc> diff(const basic_value<CharT, Alloc>& a, const basic_value<CharT, Alloc>& b);
+
+// Applies all operations of the patch or none of them: `v` is left unchanged if an operation fails. Added record
+// items go to the end, so after `apply_patch(a, diff(a, b))` value `a` is equal to `b` up to record item order,
+// which `unordered_equal` tells, though `==` can still tell them apart
+template<typename CharT, typename Alloc>
+UXS_EXPORT void apply_patch(basic_value<CharT, Alloc>& v, const basic_value<CharT, Alloc>& patch);
+
+// Tells whether values are equal regardless of record item order; values of duplicate keys are compared in order
+template<typename CharT, typename Alloc>
+UXS_EXPORT bool unordered_equal(const basic_value<CharT, Alloc>& a, const basic_value<CharT, Alloc>& b);
+
+}  // namespace json
+}  // namespace db
+}  // namespace uxs
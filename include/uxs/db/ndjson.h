@@ -0,0 +1,90 @@
+#pragma once
+
+#include "json.h"
+#include "value.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace uxs {
+namespace db {
+namespace json {
+
+struct ndjson_opts {
+    unsigned thread_count = 0;  // 0 - use hardware concurrency
+    std::size_t chunk_size = 0x100000;
+    bool ordered = true;
+};
+
+namespace detail {
+using ndjson_work_fn = std::function<void(std::size_t slot, std::string_view text, std::uint64_t ln)>;
+using ndjson_deliver_fn = std::function<void(std::size_t slot)>;
+
+// Splits input into newline-aligned chunks and calls `fn_work` for them on a pool of worker threads; `fn_deliver`
+// is called on the calling thread after `fn_work` for the same slot has finished, in input order if `opts.ordered`.
+// Slots are numbered in [0, `slot_count`), and a slot is not reused until it is delivered.
+UXS_EXPORT std::size_t ndjson_slot_count(const ndjson_opts& opts) noexcept;
+UXS_EXPORT void read_ndjson_chunks(ibuf& in, const ndjson_opts& opts, const ndjson_work_fn& fn_work,
+                                   const ndjson_deliver_fn& fn_deliver);
+
+template<typename Func>
+void for_each_ndjson_line(std::string_view text, std::uint64_t ln, const Func& fn) {
+    while (!text.empty()) {
+        const std::size_t n = text.find('\n');
+        const std::string_view line = text.substr(0, n);
+        if (std::find_if(line.begin(), line.end(), [](char ch) { return ch != ' ' && ch != '\t' && ch != '\r'; }) !=
+            line.end()) {
+            fn(line, ln);
+        }
+        if (n == std::string_view::npos) { break; }
+        text = text.substr(n + 1), ++ln;
+    }
+}
+
+[[noreturn]] UXS_EXPORT void throw_ndjson_line_error(std::uint64_t ln, const database_error& e);
+UXS_EXPORT void check_ndjson_line_end(ibuf& in, std::uint64_t ln);
+}  // namespace detail
+
+// Reads newline-delimited JSON values concurrently: lines are parsed on worker threads, and `fn(value, ln)` is
+// called on the calling thread for each value; `Alloc` must be usable from several threads at once
+template<typename CharT = char, typename Alloc = std::allocator<CharT>, typename Func>
+void read_ndjson(ibuf& in, const Func& fn, const ndjson_opts& opts = {}, const Alloc& al = Alloc()) {
+    std::vector<std::vector<std::pair<basic_value<CharT, Alloc>, std::uint64_t>>> slots(
+        detail::ndjson_slot_count(opts));
+    detail::read_ndjson_chunks(
+        in, opts,
+        [&slots, &al](std::size_t slot, std::string_view text, std::uint64_t ln) {
+            detail::for_each_ndjson_line(text, ln, [&slots, slot, &al](std::string_view line, std::uint64_t ln) {
+                iflatbuf line_in(line);
+                try {
+                    slots[slot].emplace_back(read<CharT>(line_in, al), ln);
+                } catch (const database_error& e) { detail::throw_ndjson_line_error(ln, e); }
+                detail::check_ndjson_line_end(line_in, ln);
+            });
+        },
+        [&slots, &fn](std::size_t slot) {
+            for (auto& item : slots[slot]) { fn(std::move(item.first), item.second); }
+            slots[slot].clear();
+        });
+}
+
+// Calls `fn(line_in, ln)` concurrently on worker threads for each non-empty line, so SAX `read` can be used for
+// lines; `opts.ordered` is ignored. Exceptions thrown by `fn` are passed as is, so errors of `read` refer to line 1,
+// and `fn` can use `ln` to report the line within the input
+template<typename Func>
+void parse_ndjson(ibuf& in, const Func& fn, const ndjson_opts& opts = {}) {
+    detail::read_ndjson_chunks(
+        in, opts,
+        [&fn](std::size_t, std::string_view text, std::uint64_t ln) {
+            detail::for_each_ndjson_line(text, ln, [&fn](std::string_view line, std::uint64_t ln) {
+                iflatbuf line_in(line);
+                fn(line_in, ln);
+            });
+        },
+        [](std::size_t) {});
+}
+
+}  // namespace json
+}  // namespace db
+}  // namespace uxs
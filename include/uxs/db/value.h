@@ -2,7 +2,6 @@
 
 #include "database_error.h"
 
-#include "uxs/dllist.h"  // NOLINT
 #include "uxs/iterator.h"
 #include "uxs/memory.h"
 #include "uxs/optional.h"
@@ -13,12 +12,24 @@
 #include <atomic>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <tuple>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(__x86_64__)
+#    define UXS_DB_RECORD_USE_SSE2 1
+#    include <emmintrin.h>
+#else
+#    define UXS_DB_RECORD_USE_SSE2 0
+#endif
 
 namespace uxs {
 namespace db {
 
-enum class dtype {
+enum class dtype : std::uint8_t {
     null = 0,
     boolean,
     integer,
@@ -34,6 +45,29 @@ enum class dtype {
 template<typename CharT, typename Alloc>
 class basic_value;
 
+// Heap memory of a value tree. Blocks reachable from other values through shared copy-on-write storage are
+// `shared_bytes`, and the rest are `exclusive_bytes`; each block is counted once. `slack_bytes` are unused parts of
+// counted blocks: free capacity of strings, arrays and record tables, and padding of record items
+struct value_memory_usage {
+    std::size_t exclusive_bytes = 0;
+    std::size_t shared_bytes = 0;
+    std::size_t slack_bytes = 0;
+    std::size_t type_counts[static_cast<unsigned>(dtype::record) + 1] = {};
+    std::size_t shape_count = 0;
+
+    std::size_t total_bytes() const noexcept { return exclusive_bytes + shared_bytes; }
+    std::size_t count(dtype type) const noexcept { return type_counts[static_cast<unsigned>(type)]; }
+};
+
+template<typename CharT, typename Alloc>
+class basic_shape_table;
+
+namespace detail {
+template<typename Alloc>
+using ref_count_t =
+    std::conditional_t<is_alloc_single_threaded<Alloc>::value, std::size_t, std::atomic<std::size_t>>;
+}  // namespace detail
+
 //-----------------------------------------------------------------------------
 // Flexible array implementation
 namespace detail {
@@ -42,7 +76,7 @@ template<typename Ty, typename Alloc>
 class flexarray_t {
  private:
     struct data_t {
-        std::atomic<std::size_t> ref_count;
+        ref_count_t<Alloc> ref_count;
         std::size_t size;
         std::size_t capacity;
         alignas(std::alignment_of<Ty>::value) std::uint8_t x[4 * sizeof(Ty)];
@@ -59,6 +93,7 @@ class flexarray_t {
 
     std::size_t size() const noexcept { return p_ ? p_->size : 0; }
     const_view_type cview() const noexcept { return p_ ? const_view_type(p_->data(), p_->size) : const_view_type(); }
+    bool shares_storage_with(const flexarray_t& other) const noexcept { return p_ == other.p_; }
 
     template<typename _Ty = Ty, typename = std::enable_if_t<is_character<_Ty>::value>>
     const _Ty* c_str() const noexcept {
@@ -82,6 +117,7 @@ class flexarray_t {
     }
 
     friend bool operator==(const flexarray_t& lhs, const flexarray_t& rhs) noexcept {
+        if (lhs.p_ == rhs.p_) { return true; }
         const auto lhv = lhs.cview();
         const auto rhv = rhs.cview();
         return lhv.size() == rhv.size() && std::equal(lhv.begin(), lhv.end(), rhv.begin());
@@ -168,12 +204,18 @@ class flexarray_t {
     void resize(alloc_type& al, std::size_t sz, const Ty& v);
     Ty* erase(alloc_type& al, const Ty* item_to_erase);
 
+    bool is_unique() const noexcept { return !p_ || p_->ref_count == 1; }
+    const void* storage() const noexcept { return p_; }
+    std::size_t capacity() const noexcept { return p_ ? p_->capacity - tail_zero : 0; }
+    std::size_t alloc_bytes() const noexcept { return p_ ? get_alloc_sz(p_->capacity) * sizeof(data_t) : 0; }
+
     void ref() noexcept {
         if (p_) { ++p_->ref_count; }
     }
 
     void unref(alloc_type& al) noexcept {
-        if (p_ && --p_->ref_count == 0) { destruct(al); }
+        // contents of monotonic allocators are released all at once
+        if (p_ && --p_->ref_count == 0 && !is_alloc_monotonic<alloc_type>::value) { destruct(al); }
     }
 
     void make_unique(alloc_type& al) {
@@ -337,15 +379,59 @@ void flexarray_t<Ty, Alloc>::append_impl(alloc_type& al, InputIt first, InputIt
 // Record container implementation
 namespace detail {
 
-#if UXS_ITERATOR_DEBUG_LEVEL != 0
-struct list_links_t {
-    list_links_t* next;
-    list_links_t* prev;
-    list_links_t* head;
+// Record index is an open-addressing table of node pointers with a control byte per slot: occupied slots keep 7 low
+// bits of the key hash, and `empty`, `deleted` and `sentinel` (padding of tables narrower than a group) have the high
+// bit set. Slots are probed by groups, which are matched at once.
+enum : std::int8_t { record_ctrl_empty = -128, record_ctrl_deleted = -2, record_ctrl_sentinel = -1 };
+
+inline unsigned record_ctrl_ctz(std::uint32_t x) noexcept {
+#if defined(_MSC_VER)
+    unsigned long ret;
+    _BitScanForward(&ret, x);
+    return static_cast<unsigned>(ret);
+#elif defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(x));
+#else
+    unsigned n = 0;
+    for (; !(x & 1); x >>= 1) { ++n; }
+    return n;
+#endif
+}
+
+#if UXS_DB_RECORD_USE_SSE2 != 0
+struct record_ctrl_group {
+    enum : std::size_t { width = 16 };
+    __m128i ctrl;
+    explicit record_ctrl_group(const std::int8_t* p) noexcept
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+    std::uint32_t match(std::int8_t h2) const noexcept {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+    }
+    std::uint32_t match_empty() const noexcept { return match(record_ctrl_empty); }
+    std::uint32_t match_empty_or_deleted() const noexcept {
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(record_ctrl_sentinel), ctrl)));
+    }
 };
-#else   // UXS_ITERATOR_DEBUG_LEVEL != 0
-using list_links_t = dllist_node_t;
-#endif  // UXS_ITERATOR_DEBUG_LEVEL != 0
+#else   // UXS_DB_RECORD_USE_SSE2 != 0
+struct record_ctrl_group {
+    enum : std::size_t { width = 8 };
+    const std::int8_t* ctrl;
+    explicit record_ctrl_group(const std::int8_t* p) noexcept : ctrl(p) {}
+    std::uint32_t match(std::int8_t h2) const noexcept {
+        std::uint32_t mask = 0;
+        for (unsigned i = 0; i < width; ++i) { mask |= static_cast<std::uint32_t>(ctrl[i] == h2) << i; }
+        return mask;
+    }
+    std::uint32_t match_empty() const noexcept { return match(record_ctrl_empty); }
+    std::uint32_t match_empty_or_deleted() const noexcept {
+        std::uint32_t mask = 0;
+        for (unsigned i = 0; i < width; ++i) {
+            mask |= static_cast<std::uint32_t>(ctrl[i] < record_ctrl_sentinel) << i;
+        }
+        return mask;
+    }
+};
+#endif  // UXS_DB_RECORD_USE_SSE2 != 0
 
 template<typename CharT, typename Alloc>
 class record_t;
@@ -359,7 +445,7 @@ class record_value {
     using alloc_type = typename std::allocator_traits<Alloc>::template rebind_alloc<record_value>;
     using alloc_traits = std::allocator_traits<alloc_type>;
 
-    key_type key() const noexcept { return key_type(key_chars_, key_sz_); }
+    key_type key() const noexcept { return key_type(key_, key_sz_); }
     const value_type& value() const noexcept { return *reinterpret_cast<const value_type*>(&x_); }
     value_type& value() noexcept { return *reinterpret_cast<value_type*>(&x_); }
 
@@ -368,19 +454,13 @@ class record_value {
     }
     friend bool operator!=(const record_value& lhs, const record_value& rhs) noexcept { return !(lhs == rhs); }
 
-    static record_value* from_links(list_links_t* links) noexcept {
-        return get_containing_record<record_value, offsetof(record_value, links_)>(links);
-    }
-
  private:
     friend class record_t<CharT, Alloc>;
 
-    list_links_t links_;
-    list_links_t* next_bucket_;
-    std::size_t hash_code_;
     alignas(std::alignment_of<value_type>::value) std::uint8_t x_[sizeof(value_type)];
-    std::size_t key_sz_;
-    char_type key_chars_[16];
+    const char_type* key_;  // characters following the node or interned key of the record shape
+    std::uint32_t key_sz_;
+    std::uint32_t index_;  // position in insertion order
 
     template<typename... Args>
     static record_value* create(alloc_type& al, key_type key, Args&&... args) {
@@ -400,14 +480,13 @@ class record_value {
     }
 
     static std::size_t max_name_size(const alloc_type& al) noexcept {
-        return (std::allocator_traits<alloc_type>::max_size(al) * sizeof(record_value) -
-                offsetof(record_value, key_chars_)) /
-               sizeof(CharT);
+        return std::min<std::size_t>(
+            (std::allocator_traits<alloc_type>::max_size(al) - 1) * sizeof(record_value) / sizeof(CharT),
+            std::numeric_limits<std::uint32_t>::max());
     }
 
     static std::size_t get_alloc_sz(std::size_t key_sz) noexcept {
-        return (offsetof(record_value, key_chars_) + key_sz * sizeof(CharT) + sizeof(record_value) - 1) /
-               sizeof(record_value);
+        return (2 * sizeof(record_value) + key_sz * sizeof(CharT) - 1) / sizeof(record_value);
     }
 
     UXS_NODISCARD UXS_EXPORT static record_value* alloc(alloc_type& al, key_type key);
@@ -417,20 +496,138 @@ class record_value {
     }
 };
 
-template<typename CharT, typename Alloc>
-struct record_node_traits {
-    using iterator_node_t = list_links_t;
+template<typename CharT, typename Alloc, bool Const>
+class record_iterator : public container_iterator_facade<record_t<CharT, Alloc>, record_iterator<CharT, Alloc, Const>,
+                                                         std::bidirectional_iterator_tag, Const> {
+ private:
+    using super = container_iterator_facade<record_t<CharT, Alloc>, record_iterator, std::bidirectional_iterator_tag,
+                                            Const>;
+
+ public:
+    using reference = typename super::reference;
     using node_t = record_value<CharT, Alloc>;
-    static list_links_t* get_next(list_links_t* node) { return node->next; }
-    static list_links_t* get_prev(list_links_t* node) { return node->prev; }
+
+    template<typename, typename, bool>
+    friend class record_iterator;
+
+    record_iterator() noexcept = default;
 #if UXS_ITERATOR_DEBUG_LEVEL != 0
-    static void set_head(list_links_t* node, list_links_t* head) { node->head = head; }
-    static list_links_t* get_head(list_links_t* node) { return node->head; }
-    static list_links_t* get_front(list_links_t* head) { return head->next; }
+    explicit record_iterator(node_t** ptr, node_t* const* begin, node_t* const* end) noexcept
+        : ptr_(ptr), begin_(begin), end_(end) {}
+    template<bool Const_ = Const>
+    record_iterator(const std::enable_if_t<Const_, record_iterator<CharT, Alloc, false>>& it) noexcept
+        : ptr_(it.ptr_), begin_(it.begin_), end_(it.end_) {}
+    template<bool Const_ = Const>
+    record_iterator& operator=(const std::enable_if_t<Const_, record_iterator<CharT, Alloc, false>>& it) noexcept {
+        ptr_ = it.ptr_, begin_ = it.begin_, end_ = it.end_;
+        return *this;
+    }
 #else   // UXS_ITERATOR_DEBUG_LEVEL != 0
-    static void set_head(list_links_t* /*node*/, list_links_t* /*head*/) {}
+    explicit record_iterator(node_t** ptr, node_t* const* begin, node_t* const* end) noexcept : ptr_(ptr) {
+        (void)begin, (void)end;
+    }
+    template<bool Const_ = Const>
+    record_iterator(const std::enable_if_t<Const_, record_iterator<CharT, Alloc, false>>& it) noexcept
+        : ptr_(it.ptr_) {}
+    template<bool Const_ = Const>
+    record_iterator& operator=(const std::enable_if_t<Const_, record_iterator<CharT, Alloc, false>>& it) noexcept {
+        ptr_ = it.ptr_;
+        return *this;
+    }
+#endif  // UXS_ITERATOR_DEBUG_LEVEL != 0
+
+    void increment() noexcept {
+        assert(ptr_);
+        uxs_iterator_assert(begin_ <= ptr_ && ptr_ < end_);
+        while (!*++ptr_) {}  // places of erased items are skipped
+    }
+
+    void decrement() noexcept {
+        assert(ptr_);
+        uxs_iterator_assert(begin_ < ptr_ && ptr_ <= end_);
+        while (!*--ptr_) {}
+    }
+
+    template<bool Const2>
+    bool is_equal_to(const record_iterator<CharT, Alloc, Const2>& it) const noexcept {
+        assert((!ptr_ && !it.ptr_) || (ptr_ && it.ptr_));
+        uxs_iterator_assert(begin_ == it.begin_ && end_ == it.end_);
+        return ptr_ == it.ptr_;
+    }
+
+    reference dereference() const noexcept {
+        assert(ptr_);
+        uxs_iterator_assert(begin_ <= ptr_ && ptr_ < end_);
+        return **ptr_;
+    }
+
+    node_t** ptr() const noexcept { return ptr_; }
+
+ private:
+    node_t** ptr_ = nullptr;
+#if UXS_ITERATOR_DEBUG_LEVEL != 0
+    node_t* const* begin_ = nullptr;
+    node_t* const* end_ = nullptr;
 #endif  // UXS_ITERATOR_DEBUG_LEVEL != 0
-    static record_value<CharT, Alloc>& get_value(list_links_t* node) { return *node_t::from_links(node); }
+};
+
+// Record shape is an interned key set, which is shared by records having the same keys in the same order: such
+// records keep their values together and look them up through the index of the shape. Keys, their index (positions
+// of keys in slots of the same layout as the record index) and characters of keys follow the header in the same block
+template<typename CharT, typename Alloc>
+class record_shape {
+ public:
+    using node_t = record_value<CharT, Alloc>;
+    using alloc_type = typename std::allocator_traits<Alloc>::template rebind_alloc<record_shape>;
+    using alloc_traits = std::allocator_traits<alloc_type>;
+    using key_type = std::basic_string_view<CharT>;
+
+    std::size_t size() const noexcept { return size_; }
+    std::size_t hash_code() const noexcept { return hash_code_; }
+    const key_type* keys() const noexcept { return reinterpret_cast<const key_type*>(this + 1); }
+
+    bool equal_keys(node_t* const* nodes, std::size_t count) const noexcept {
+        return count == size_ && std::equal(nodes, nodes + count, keys(),
+                                            [](const node_t* node, key_type key) { return node->key() == key; });
+    }
+
+    // Returns position of the key or `size()` if not found
+    UXS_EXPORT std::size_t find(key_type key, std::size_t hash_code) const noexcept;
+
+    bool is_unique() const noexcept { return ref_count_ == 1; }
+    std::size_t alloc_bytes() const noexcept { return alloc_sz_ * sizeof(record_shape); }
+
+    void ref() noexcept { ++ref_count_; }
+
+    // The shape is released with a copy of the allocator it was made with, which is kept in the shape, so records
+    // don't need the allocator of the shape table
+    void unref() noexcept {
+        if (--ref_count_ == 0 && !is_alloc_monotonic<alloc_type>::value) {
+            alloc_type al(std::move(al_));
+            al_.~alloc_type();
+            alloc_traits::deallocate(al, this, alloc_sz_);
+        }
+    }
+
+    // Returns `nullptr` if keys are not unique
+    UXS_NODISCARD UXS_EXPORT static record_shape* create(alloc_type& al, node_t* const* nodes, std::size_t count,
+                                                         std::size_t hash_code);
+
+ private:
+    ref_count_t<Alloc> ref_count_;
+    std::size_t size_;
+    std::size_t bucket_count_;
+    std::size_t hash_code_;
+    std::size_t alloc_sz_;
+    alloc_type al_;
+
+    key_type* key_storage() noexcept { return reinterpret_cast<key_type*>(this + 1); }
+    const std::uint32_t* positions() const noexcept { return reinterpret_cast<const std::uint32_t*>(keys() + size_); }
+    std::uint32_t* positions() noexcept { return reinterpret_cast<std::uint32_t*>(key_storage() + size_); }
+    const std::int8_t* ctrl() const noexcept {
+        return reinterpret_cast<const std::int8_t*>(positions() + bucket_count_);
+    }
+    std::int8_t* ctrl() noexcept { return reinterpret_cast<std::int8_t*>(positions() + bucket_count_); }
 };
 
 template<typename RandIt>
@@ -445,15 +642,37 @@ std::false_type initial_alloc_size(InputIt /*first*/, InputIt /*last*/, std::fal
 
 template<typename CharT, typename Alloc>
 class record_t {
+ public:
+    using node_t = record_value<CharT, Alloc>;
+    using shape_t = record_shape<CharT, Alloc>;
+
  private:
+    // Nodes in insertion order follow the header in the same block. Indexed records keep slots and control bytes of
+    // the index after them, and nodes are allocated one by one. Small and shaped records have no index, and the nodes
+    // themselves follow the node pointers, then key characters of small records. Erasing an item of an indexed record
+    // leaves a null place in the node pointers, which are packed when there are more such places than items. The
+    // node pointers are followed by a non-null end mark, so iterators skip null places without knowing the end. Nodes
+    // of a small record are never moved: when it outgrows its block, they are indexed in place, and the block is kept
+    // as `small`
     struct data_t {
-        std::atomic<std::size_t> ref_count;
-        list_links_t head;
+        ref_count_t<Alloc> ref_count;
         std::size_t size;
-        std::size_t bucket_count;
-        list_links_t* hashtbl[4];
-        UXS_EXPORT void init() noexcept;
-        void init_from(data_t* p) noexcept;
+        std::size_t bucket_count;  // zero for small and shaped records
+        shape_t* shape;
+        data_t* small;
+        std::uint32_t capacity;       // node places of small and shaped records
+        std::uint32_t key_capacity;   // key characters of small records
+        std::uint32_t deleted_count;  // deleted slots of indexed records
+        std::uint32_t erased_count;   // null places of indexed records
+        std::uint32_t first;          // place of the first item
+        node_t** nodes() noexcept { return reinterpret_cast<node_t**>(this + 1); }
+        node_t** nodes_end() noexcept { return nodes() + size + erased_count; }
+        void put_end_mark() noexcept { *nodes_end() = reinterpret_cast<node_t*>(this); }
+        node_t* inline_nodes() noexcept { return reinterpret_cast<node_t*>(nodes() + capacity + 1); }
+        CharT* key_chars() noexcept { return reinterpret_cast<CharT*>(inline_nodes() + capacity); }
+        node_t** slots() noexcept { return nodes() + get_capacity(bucket_count) + 1; }
+        std::int8_t* ctrl() noexcept { return reinterpret_cast<std::int8_t*>(slots() + bucket_count); }
+        UXS_EXPORT void reset_index() noexcept;
     };
 
  public:
@@ -468,41 +687,48 @@ class record_t {
     using const_pointer = const value_type*;
     using reference = value_type&;
     using const_reference = const value_type&;
-    using node_traits = record_node_traits<CharT, Alloc>;
-    using node_t = typename node_traits::node_t;
     using hasher_t = std::hash<key_type>;
-    using iterator = list_iterator<record_t, node_traits, false>;
-    using const_iterator = list_iterator<record_t, node_traits, true>;
+    using iterator = record_iterator<CharT, Alloc, false>;
+    using const_iterator = record_iterator<CharT, Alloc, true>;
+
+    friend class record_shape<CharT, Alloc>;
 
     size_type size() const noexcept { return p_->size; }
-    list_links_t* cbegin() const noexcept { return p_->head.next; }
-    list_links_t* cend() const noexcept { return &p_->head; }
-    list_links_t* find(key_type key) const noexcept { return find_impl(key, hasher_t{}(key)); }
+    node_t** cbegin() const noexcept { return p_->nodes() + p_->first; }
+    node_t** cend() const noexcept { return p_->nodes_end(); }
+    node_t** find(key_type key) const noexcept {
+        node_t* node = find_node(key);
+        return node ? p_->nodes() + node->index_ : cend();
+    }
     UXS_EXPORT size_type count(key_type key) const noexcept;
 
     iterator_range<const_iterator> crange() const {
-        return make_range(const_iterator(cbegin()), const_iterator(cend()));
+        return make_range(const_iterator(cbegin(), cbegin(), cend()), const_iterator(cend(), cbegin(), cend()));
     }
 
     iterator_range<iterator> range(alloc_type& al) {
         make_unique(al);
-        return make_range(iterator(cbegin()), iterator(cend()));
+        return make_range(iterator(cbegin(), cbegin(), cend()), iterator(cend(), cbegin(), cend()));
     }
 
     friend bool operator==(const record_t& lhs, const record_t& rhs) noexcept {
-        return lhs.size() == rhs.size() &&
-               std::equal(const_iterator(lhs.cbegin()), const_iterator(lhs.cend()), const_iterator(rhs.cbegin()));
+        if (lhs.p_ == rhs.p_) { return true; }
+        if (lhs.size() != rhs.size()) { return false; }
+        const auto lhs_range = lhs.crange();
+        return std::equal(lhs_range.begin(), lhs_range.end(), rhs.crange().begin());
     }
 
-    void construct(alloc_type& al, std::false_type = {}) {
-        p_ = alloc(al, 0);
-        p_->init();
-    }
+    void construct(alloc_type& al, std::false_type = {}) { p_ = alloc_small(al, 0, 0); }
 
-    void construct(alloc_type& al, std::size_t bucket_count) {
-        if (bucket_count > max_size(al)) { throw std::length_error("too much to reserve"); }
-        p_ = alloc(al, bucket_count);
-        p_->init();
+    void construct(alloc_type& al, std::size_t count) { construct(al, count, count * small_key_reserve); }
+
+    void construct(alloc_type& al, std::size_t count, std::size_t key_count) {
+        if (count <= small_max_size) {
+            p_ = alloc_small(al, count, key_count);
+            return;
+        }
+        if (count > max_size(al)) { throw std::length_error("too much to reserve"); }
+        p_ = alloc(al, get_bucket_count(count));
     }
 
     void construct(alloc_type& al, record_t rec);
@@ -511,7 +737,7 @@ class record_t {
 
     template<typename InputIt>
     void construct(alloc_type& al, InputIt first, InputIt last) {
-        construct(al, initial_alloc_size(first, last, is_random_access_iterator<InputIt>()));
+        construct_for(al, first, last, is_random_access_iterator<InputIt>());
         try {
             insert_impl(al, first, last, is_random_access_iterator<InputIt>());
         } catch (...) {
@@ -530,41 +756,50 @@ class record_t {
 
     template<typename InputIt>
     void insert(alloc_type& al, InputIt first, InputIt last) {
-        make_unique(al);
+        make_unique_unshaped(al);
         insert_impl(al, first, last, is_random_access_iterator<InputIt>());
     }
 
     template<typename... Args>
-    list_links_t* emplace(alloc_type& al, key_type key, Args&&... args) {
-        make_unique(al);
-        if (p_->size == p_->bucket_count) { rehash(al, 1); }
-        typename node_t::alloc_type node_al(al);
-        node_t* node = node_t::create(node_al, key, std::forward<Args>(args)...);
-        insert_node(node, hasher_t{}(key));
-        return &node->links_;
+    node_t** emplace(alloc_type& al, key_type key, Args&&... args) {
+        make_unique_unshaped(al);
+        return emplace_impl(al, key, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    std::pair<list_links_t*, bool> emplace_unique(alloc_type& al, key_type key, Args&&... args) {
+    std::pair<node_t**, bool> emplace_unique(alloc_type& al, key_type key, Args&&... args) {
         make_unique(al);
-        const std::size_t hash_code = hasher_t{}(key);
-        list_links_t* node = find_impl(key, hash_code);
-        if (node != &p_->head) { return std::make_pair(node, false); }
-        if (p_->size == p_->bucket_count) { rehash(al, 1); }
-        typename node_t::alloc_type node_al(al);
-        node_t* new_node = node_t::create(node_al, key, std::forward<Args>(args)...);
-        insert_node(new_node, hash_code);
-        return std::make_pair(&new_node->links_, true);
+        node_t* node = find_node(key);
+        if (node) { return std::make_pair(p_->nodes() + node->index_, false); }
+        if (p_->shape) { unshape(al); }
+        return std::make_pair(emplace_impl(al, key, std::forward<Args>(args)...), true);
     }
 
     void clear(alloc_type& al) { clear_impl(al); }
-    list_links_t* erase(alloc_type& al, list_links_t* node);
+    void reserve(alloc_type& al, std::size_t count) {
+        if (count <= p_->size) { return; }
+        make_unique_unshaped(al);
+        grow(al, count - p_->size, (count - p_->size) * small_key_reserve);
+    }
+    node_t** erase(alloc_type& al, node_t** pos);
     std::size_t erase(alloc_type& al, key_type key);
 
+    bool is_shaped() const noexcept { return p_->shape != nullptr; }
+    bool is_small() const noexcept { return !p_->bucket_count && !p_->shape; }
+    bool shares_storage_with(const record_t& other) const noexcept { return p_ == other.p_; }
+    UXS_EXPORT void share_keys(alloc_type& al, basic_shape_table<CharT, Alloc>& shapes);
+
+    bool is_unique() const noexcept { return p_->ref_count == 1; }
+    const void* storage() const noexcept { return p_; }
+    const shape_t* shape() const noexcept { return p_->shape; }
+
+    // Adds sizes of the record block and nodes to `bytes`, and their unused parts to `slack`
+    UXS_EXPORT void count_memory(std::size_t& bytes, std::size_t& slack) const noexcept;
+
     void ref() noexcept { ++p_->ref_count; }
 
     void unref(alloc_type& al) noexcept {
-        if (--p_->ref_count == 0) { destruct(al); }
+        if (--p_->ref_count == 0 && !is_alloc_monotonic<alloc_type>::value) { destruct(al); }
     }
 
     void make_unique(alloc_type& al) {
@@ -574,6 +809,33 @@ class record_t {
  private:
     data_t* p_;
 
+    void make_unique_unshaped(alloc_type& al) {
+        if (p_->shape) {
+            unshape(al);
+        } else {
+            make_unique(al);
+        }
+    }
+
+    template<typename RandIt>
+    void construct_for(alloc_type& al, RandIt first, RandIt last, std::true_type /* random access iterator */) {
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        construct(al, count, count <= small_max_size ? get_key_count(first, last) : 0);
+    }
+
+    template<typename InputIt>
+    void construct_for(alloc_type& al, InputIt /*first*/, InputIt /*last*/,
+                       std::false_type /* random access iterator */) {
+        construct(al);
+    }
+
+    template<typename RandIt>
+    static std::size_t get_key_count(RandIt first, RandIt last) {
+        std::size_t key_count = 0;
+        for (; first != last; ++first) { key_count += key_type(std::get<0>(*first)).size(); }
+        return key_count;
+    }
+
     void insert_impl(alloc_type& al, std::initializer_list<mapped_type> init);
 
     template<typename RandIt>
@@ -581,34 +843,172 @@ class record_t {
     template<typename InputIt>
     void insert_impl(alloc_type& al, InputIt first, InputIt last, std::false_type /* random access iterator */);
 
+    std::size_t growth_left() const noexcept {
+        return get_capacity(p_->bucket_count) - p_->size - std::max(p_->deleted_count, p_->erased_count);
+    }
+
+    // Makes room for `extra` items with `key_count` key characters: small records stay small while there are free
+    // places for them, and an empty one takes a block of `extra` places
+    void grow(alloc_type& al, std::size_t extra, std::size_t key_count) {
+        if (!is_small()) {
+            if (growth_left() < extra) { rehash(al, extra); }
+        } else if (extra > (p_->size ? p_->capacity : static_cast<std::size_t>(small_max_size)) - p_->size) {
+            rehash(al, extra);
+        } else if (!p_->size && (extra > p_->capacity || key_count > p_->key_capacity)) {
+            reset(al, alloc_small(al, extra, key_count));
+        }
+    }
+
+    node_t* find_node(key_type key) const noexcept {
+        return is_small() ? find_small(key) : find_impl(key, hasher_t{}(key));
+    }
+
+    node_t* find_small(key_type key) const noexcept {
+        // the latest of equal keys is found
+        for (node_t* const* pos = cend(); pos != cbegin();) {
+            if ((*--pos)->key() == key) { return *pos; }
+        }
+        return nullptr;
+    }
+
+    std::size_t small_key_size() const noexcept {
+        // characters of erased items are left unused, so keys are added after the farthest one of the remaining items
+        std::size_t key_sz = 0;
+        for (const node_t* node : est::as_span(p_->nodes(), p_->size)) {
+            key_sz = std::max(key_sz, static_cast<std::size_t>(node->key_ - p_->key_chars()) + node->key_sz_);
+        }
+        return key_sz;
+    }
+
+    bool fits_small(key_type key) const noexcept {
+        // a new block is allocated only for the first item, so that items already added are not moved
+        if (!p_->size) { return key.size() <= small_max_key_size; }
+        return p_->size < p_->capacity && key.size() <= p_->key_capacity - small_key_size();
+    }
+
+    template<typename... Args>
+    node_t** emplace_impl(alloc_type& al, key_type key, Args&&... args) {
+        if (is_small() && fits_small(key)) { return emplace_small(al, key, std::forward<Args>(args)...); }
+        typename node_t::alloc_type node_al(al);
+        node_t* node = node_t::create(node_al, key, std::forward<Args>(args)...);
+        if (is_small() || !growth_left()) {
+            try {
+                rehash(al, 1);
+            } catch (...) {
+                node_t::destroy(node_al, node);
+                throw;
+            }
+        }
+        return insert_node(node, hasher_t{}(key));
+    }
+
+    template<typename... Args>
+    node_t** emplace_small(alloc_type& al, key_type key, Args&&... args) {
+        data_t* p = p_;
+        if (!p_->size && (!p_->capacity || key.size() > p_->key_capacity)) {
+            // places reserved for an empty record are kept
+            const std::size_t cap = p_->capacity ? p_->capacity : static_cast<std::size_t>(small_max_size);
+            p = alloc_small(al, cap, std::max(cap * small_key_reserve, key.size() + (cap - 1) * small_key_reserve));
+        }
+        node_t* node = p->inline_nodes();
+        while (node->key_) { ++node; }  // places of erased items are free
+        typename node_t::alloc_type node_al(al);
+        try {
+            node_t::alloc_traits::construct(node_al, &node->value(), std::forward<Args>(args)...);
+        } catch (...) {
+            if (p != p_) { dealloc(al, p); }
+            throw;
+        }
+        if (p != p_) { reset(al, p); }
+        CharT* key_chars = p_->key_chars() + small_key_size();
+        std::copy_n(key.data(), key.size(), key_chars);
+        node->key_ = key_chars;
+        node->key_sz_ = static_cast<std::uint32_t>(key.size());
+        node->index_ = static_cast<std::uint32_t>(p_->size);
+        node_t** pos = p_->nodes() + p_->size++;
+        *pos = node;
+        return pos;
+    }
+
+    std::size_t small_key_count() const noexcept {
+        std::size_t count = 0;
+        for (const node_t& node : crange()) { count += node.key_sz_; }
+        return count;
+    }
+
+    bool is_inline_node(const node_t* node) const noexcept {
+        if (!p_->small) { return false; }
+        const node_t* first = p_->small->inline_nodes();
+        return !std::less<const node_t*>{}(node, first) &&
+               std::less<const node_t*>{}(node, first + p_->small->capacity);
+    }
+
+    void destroy_node(alloc_type& al, node_t* node) noexcept;
     void destruct_items(alloc_type& al) noexcept;
-    void add_to_hash(node_t* node) noexcept;
-    UXS_EXPORT void insert_node(node_t* node, std::size_t hash_code) noexcept;
+    void remove_node(alloc_type& al, std::size_t slot) noexcept;
+    UXS_EXPORT void pack_nodes() noexcept;
+    UXS_EXPORT void add_to_index(node_t* node, std::size_t hash_code) noexcept;
+    UXS_EXPORT node_t** insert_node(node_t* node, std::size_t hash_code) noexcept;
     UXS_EXPORT void rehash(alloc_type& al, std::size_t extra);
     UXS_EXPORT void make_unique_impl(alloc_type& al);
+    UXS_EXPORT void copy_nodes(alloc_type& al, const record_t& rec);
+    UXS_EXPORT void unshape(alloc_type& al);
     UXS_EXPORT void clear_impl(alloc_type& al, std::false_type = {});
-    UXS_EXPORT void clear_impl(alloc_type& al, std::size_t bucket_count);
+    UXS_EXPORT void clear_impl(alloc_type& al, std::size_t count);
     UXS_EXPORT void destruct(alloc_type& al) noexcept;
-    UXS_EXPORT list_links_t* find_impl(key_type key, std::size_t hash_code) const noexcept;
+    UXS_EXPORT node_t* find_impl(key_type key, std::size_t hash_code) const noexcept;
+    UXS_EXPORT void erase_small(alloc_type& al, std::size_t index) noexcept;
 
     void reset(alloc_type& al, data_t* p) noexcept {
         unref(al);
         p_ = p;
     }
 
+    // Records with few items are small: values and keys are kept in the record block and looked up one by one
+    enum : std::size_t { small_max_size = 8, small_max_key_size = 255, small_key_reserve = 8 };
+
+    // Tables not wider than a group are probed at once, so they can be filled up completely
+    static std::size_t get_capacity(std::size_t bucket_count) noexcept {
+        return bucket_count <= record_ctrl_group::width ? bucket_count : bucket_count - (bucket_count >> 3);
+    }
+
+    static std::size_t get_bucket_count(std::size_t count) noexcept {
+        std::size_t bucket_count = count ? 4 : 0;
+        while (get_capacity(bucket_count) < count) { bucket_count <<= 1; }
+        return bucket_count;
+    }
+
+    static std::size_t get_ctrl_size(std::size_t bucket_count) noexcept {
+        return bucket_count ? std::max<std::size_t>(bucket_count, record_ctrl_group::width) : 0;
+    }
+
     static std::size_t max_size(const alloc_type& al) noexcept {
-        return (std::allocator_traits<alloc_type>::max_size(al) * sizeof(data_t) - offsetof(data_t, hashtbl)) /
-               sizeof(list_links_t*);
+        return std::min<std::size_t>(
+            (std::allocator_traits<alloc_type>::max_size(al) - 1) * sizeof(data_t) / (3 * sizeof(node_t*)),
+            std::numeric_limits<std::uint32_t>::max());
     }
 
     static std::size_t get_alloc_sz(std::size_t bucket_count) noexcept {
-        return (offsetof(data_t, hashtbl) + bucket_count * sizeof(list_links_t*) + sizeof(data_t) - 1) / sizeof(data_t);
+        return (2 * sizeof(data_t) + (get_capacity(bucket_count) + bucket_count + 1) * sizeof(node_t*) +
+                get_ctrl_size(bucket_count) - 1) /
+               sizeof(data_t);
+    }
+
+    static std::size_t get_small_alloc_sz(std::size_t capacity, std::size_t key_capacity) noexcept {
+        return (2 * sizeof(data_t) + capacity * (sizeof(node_t*) + sizeof(node_t)) + sizeof(node_t*) +
+                key_capacity * sizeof(CharT) - 1) /
+               sizeof(data_t);
     }
 
     UXS_NODISCARD UXS_EXPORT static data_t* alloc(alloc_type& al, std::size_t bucket_count);
+    UXS_NODISCARD UXS_EXPORT static data_t* alloc_small(alloc_type& al, std::size_t capacity,
+                                                        std::size_t key_capacity);
+    UXS_NODISCARD UXS_EXPORT static data_t* alloc_shaped(alloc_type& al, shape_t* shape);
 
     static void dealloc(alloc_type& al, data_t* rec) noexcept {
-        alloc_traits::deallocate(al, rec, get_alloc_sz(rec->bucket_count));
+        alloc_traits::deallocate(al, rec,
+                                 rec->bucket_count ? get_alloc_sz(rec->bucket_count) :
+                                                     get_small_alloc_sz(rec->capacity, rec->key_capacity));
     }
 };
 
@@ -617,26 +1017,15 @@ template<typename RandIt>
 void record_t<CharT, Alloc>::insert_impl(alloc_type& al, RandIt first, RandIt last,
                                          std::true_type /* random access iterator */) {
     const std::size_t count = static_cast<std::size_t>(last - first);
-    if (p_->bucket_count - p_->size < count) { rehash(al, count); }
-    typename node_t::alloc_type node_al(al);
-    for (; first != last; ++first) {
-        const auto key = std::get<0>(*first);
-        node_t* node = node_t::create(node_al, key, std::get<1>(*first));
-        insert_node(node, hasher_t{}(key));
-    }
+    grow(al, count, is_small() && !p_->size && count <= small_max_size ? get_key_count(first, last) : 0);
+    for (; first != last; ++first) { emplace_impl(al, std::get<0>(*first), std::get<1>(*first)); }
 }
 
 template<typename CharT, typename Alloc>
 template<typename InputIt>
 void record_t<CharT, Alloc>::insert_impl(alloc_type& al, InputIt first, InputIt last,
                                          std::false_type /* random access iterator */) {
-    typename node_t::alloc_type node_al(al);
-    for (; first != last; ++first) {
-        if (p_->size == p_->bucket_count) { rehash(al, 1); }
-        const auto key = std::get<0>(*first);
-        node_t* node = node_t::create(node_al, key, std::get<1>(*first));
-        insert_node(node, hasher_t{}(key));
-    }
+    for (; first != last; ++first) { emplace_impl(al, std::get<0>(*first), std::get<1>(*first)); }
 }
 
 //-----------------------------------------------------------------------------
@@ -648,6 +1037,7 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
  public:
     using key_type = std::basic_string_view<CharT>;
     using value_type = basic_value<CharT, Alloc>;
+    using node_t = record_value<CharT, Alloc>;
 
     template<typename, typename, bool>
     friend class value_iterator;
@@ -657,6 +1047,8 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
 #if UXS_ITERATOR_DEBUG_LEVEL != 0
     explicit value_iterator(value_type* ptr, const value_type* begin, const value_type* end) noexcept
         : ptr_(ptr), begin_(begin), end_(end) {}
+    explicit value_iterator(node_t** ptr, node_t* const* begin, node_t* const* end) noexcept
+        : is_record_(true), ptr_(ptr), begin_(begin), end_(end) {}
     template<bool Const_ = Const>
     value_iterator(const std::enable_if_t<Const_, value_iterator<CharT, Alloc, false>>& it) noexcept
         : is_record_(it.is_record_), ptr_(it.ptr_), begin_(it.begin_), end_(it.end_) {}
@@ -670,6 +1062,10 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
         : is_record_(false), ptr_(ptr) {
         (void)begin, (void)end;
     }
+    explicit value_iterator(node_t** ptr, node_t* const* begin, node_t* const* end) noexcept
+        : is_record_(true), ptr_(ptr) {
+        (void)begin, (void)end;
+    }
     template<bool Const_ = Const>
     value_iterator(const std::enable_if_t<Const_, value_iterator<CharT, Alloc, false>>& it) noexcept
         : is_record_(it.is_record_), ptr_(it.ptr_) {}
@@ -679,27 +1075,36 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
         return *this;
     }
 #endif  // UXS_ITERATOR_DEBUG_LEVEL != 0
-    explicit value_iterator(list_links_t* node) noexcept : is_record_(true), ptr_(node) {}
 
     void increment() noexcept {
         assert(ptr_);
-        uxs_iterator_assert(is_record_ ? ptr_ != head() : begin_ <= ptr_ && ptr_ < end_);
-        ptr_ = is_record_ ? static_cast<void*>(static_cast<list_links_t*>(ptr_)->next) :
-                            static_cast<void*>(static_cast<value_type*>(ptr_) + 1);
+        uxs_iterator_assert(begin_ <= ptr_ && ptr_ < end_);
+        if (is_record_) {
+            node_t** pos = static_cast<node_t**>(ptr_);
+            while (!*++pos) {}  // places of erased items are skipped
+            ptr_ = pos;
+        } else {
+            ptr_ = static_cast<value_type*>(ptr_) + 1;
+        }
     }
 
     void decrement() noexcept {
         assert(ptr_);
-        uxs_iterator_assert(is_record_ ? ptr_ != head()->next : begin_ < ptr_ && ptr_ <= end_);
-        ptr_ = is_record_ ? static_cast<void*>(static_cast<list_links_t*>(ptr_)->prev) :
-                            static_cast<void*>(static_cast<value_type*>(ptr_) - 1);
+        uxs_iterator_assert(begin_ < ptr_ && ptr_ <= end_);
+        if (is_record_) {
+            node_t** pos = static_cast<node_t**>(ptr_);
+            while (!*--pos) {}
+            ptr_ = pos;
+        } else {
+            ptr_ = static_cast<value_type*>(ptr_) - 1;
+        }
     }
 
     template<bool Const2>
     bool is_equal_to(const value_iterator<CharT, Alloc, Const2>& it) const noexcept {
         assert(is_record_ == it.is_record_);
-        assert(!is_record_ || (!ptr_ && !it.ptr_) || (ptr_ && it.ptr_));
-        uxs_iterator_assert(is_record_ ? !ptr_ || head() == it.head() : begin_ == it.begin_ && end_ == it.end_);
+        assert((!ptr_ && !it.ptr_) || (ptr_ && it.ptr_));
+        uxs_iterator_assert(begin_ == it.begin_ && end_ == it.end_);
         return ptr_ == it.ptr_;
     }
 
@@ -709,14 +1114,13 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
 
     key_type key() const {
         if (!is_record_) { throw database_error("cannot use key() for non-record iterators"); }
-        return record_value<CharT, Alloc>::from_links(static_cast<list_links_t*>(ptr_))->key();
+        return (*static_cast<node_t**>(ptr_))->key();
     }
 
     std::conditional_t<Const, const value_type&, value_type&> value() const noexcept {
         assert(ptr_);
-        uxs_iterator_assert(is_record_ ? ptr_ != head() : begin_ <= ptr_ && ptr_ < end_);
-        return is_record_ ? record_value<CharT, Alloc>::from_links(static_cast<list_links_t*>(ptr_))->value() :
-                            *static_cast<value_type*>(ptr_);
+        uxs_iterator_assert(begin_ <= ptr_ && ptr_ < end_);
+        return is_record_ ? (*static_cast<node_t**>(ptr_))->value() : *static_cast<value_type*>(ptr_);
     }
 
  private:
@@ -725,7 +1129,6 @@ class value_iterator : public container_iterator_facade<basic_value<CharT, Alloc
 #if UXS_ITERATOR_DEBUG_LEVEL != 0
     const void* begin_ = nullptr;
     const void* end_ = nullptr;
-    list_links_t* head() const noexcept { return static_cast<list_links_t*>(ptr_)->head; }
 #endif  // UXS_ITERATOR_DEBUG_LEVEL != 0
 };
 
@@ -805,42 +1208,36 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     using const_reference = const_iterator;
 
     basic_value() noexcept(std::is_nothrow_default_constructible<alloc_type>::value)
-        : alloc_type(), type_(dtype::null) {}
+        : alloc_type(), data_(dtype::null) {}
     basic_value(std::nullptr_t) noexcept(std::is_nothrow_default_constructible<alloc_type>::value)
-        : alloc_type(), type_(dtype::null) {}
+        : alloc_type(), data_(dtype::null) {}
     basic_value(string_variant_t) noexcept(std::is_nothrow_default_constructible<alloc_type>::value)
-        : alloc_type(), type_(dtype::string) {
-        value_.str.construct();
+        : alloc_type(), data_(dtype::string) {
+        init_sso();
     }
     basic_value(array_variant_t) noexcept(std::is_nothrow_default_constructible<alloc_type>::value)
-        : alloc_type(), type_(dtype::array) {
-        value_.arr.construct();
+        : alloc_type(), data_(dtype::array) {
+        data_.value.arr.construct();
     }
-    basic_value(record_variant_t) : alloc_type(), type_(dtype::record) {
+    basic_value(record_variant_t) : alloc_type(), data_(dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.construct(rec_al);
-    }
-    basic_value(std::basic_string_view<char_type> s) : alloc_type(), type_(dtype::string) {
-        typename char_array_t::alloc_type str_al(*this);
-        value_.str.construct(str_al, s);
+        data_.value.rec.construct(rec_al);
     }
+    basic_value(std::basic_string_view<char_type> s) : alloc_type(), data_(dtype::string) { construct_string(s); }
     basic_value(const char_type* cstr) : basic_value(std::basic_string_view<char_type>(cstr)) {}
 
-    explicit basic_value(const Alloc& al) noexcept : alloc_type(al), type_(dtype::null) {}
-    basic_value(std::nullptr_t, const Alloc& al) noexcept : alloc_type(al), type_(dtype::null) {}
-    basic_value(string_variant_t, const Alloc& al) noexcept : alloc_type(al), type_(dtype::string) {
-        value_.str.construct();
-    }
-    basic_value(array_variant_t, const Alloc& al) noexcept : alloc_type(al), type_(dtype::array) {
-        value_.arr.construct();
+    explicit basic_value(const Alloc& al) noexcept : alloc_type(al), data_(dtype::null) {}
+    basic_value(std::nullptr_t, const Alloc& al) noexcept : alloc_type(al), data_(dtype::null) {}
+    basic_value(string_variant_t, const Alloc& al) noexcept : alloc_type(al), data_(dtype::string) { init_sso(); }
+    basic_value(array_variant_t, const Alloc& al) noexcept : alloc_type(al), data_(dtype::array) {
+        data_.value.arr.construct();
     }
-    basic_value(record_variant_t, const Alloc& al) : alloc_type(al), type_(dtype::record) {
+    basic_value(record_variant_t, const Alloc& al) : alloc_type(al), data_(dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.construct(rec_al);
+        data_.value.rec.construct(rec_al);
     }
-    basic_value(std::basic_string_view<char_type> s, const Alloc& al) : alloc_type(al), type_(dtype::string) {
-        typename char_array_t::alloc_type str_al(*this);
-        value_.str.construct(str_al, s);
+    basic_value(std::basic_string_view<char_type> s, const Alloc& al) : alloc_type(al), data_(dtype::string) {
+        construct_string(s);
     }
     basic_value(const char_type* cstr, const Alloc& al) : basic_value(std::basic_string_view<char_type>(cstr), al) {}
 
@@ -849,52 +1246,52 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
         : basic_value(detail::select_construct_t<CharT, Alloc, InputIt>(), first, last, al) {}
     template<typename InputIt, typename = std::enable_if_t<is_input_iterator<InputIt>::value>>
     basic_value(array_variant_t, InputIt first, InputIt last, const Alloc& al = Alloc())
-        : alloc_type(al), type_(dtype::array) {
+        : alloc_type(al), data_(dtype::array) {
         typename value_array_t::alloc_type arr_al(*this);
-        value_.arr.construct(arr_al, first, last);
+        data_.value.arr.construct(arr_al, first, last);
     }
     template<typename InputIt, typename = std::enable_if_t<is_input_iterator<InputIt>::value &&
                                                            detail::is_record_iterator<CharT, Alloc, InputIt>::value>>
     basic_value(record_variant_t, InputIt first, InputIt last, const Alloc& al = Alloc())
-        : alloc_type(al), type_(dtype::record) {
+        : alloc_type(al), data_(dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.construct(rec_al, first, last);
+        data_.value.rec.construct(rec_al, first, last);
     }
 
     UXS_EXPORT basic_value(std::initializer_list<basic_value> init, const Alloc& al = Alloc());
     basic_value(array_variant_t, std::initializer_list<basic_value> init, const Alloc& al = Alloc())
-        : alloc_type(al), type_(dtype::array) {
+        : alloc_type(al), data_(dtype::array) {
         typename value_array_t::alloc_type arr_al(al);
-        value_.arr.construct(arr_al, init);
+        data_.value.arr.construct(arr_al, init);
     }
     basic_value(record_variant_t, std::initializer_list<std::pair<key_type, basic_value>> init,
                 const Alloc& al = Alloc())
-        : alloc_type(al), type_(dtype::record) {
+        : alloc_type(al), data_(dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.construct(rec_al, init);
+        data_.value.rec.construct(rec_al, init);
     }
 
     template<typename Func>
-    basic_value(dtype type, const Func& func, const Alloc& al = Alloc()) : alloc_type(al), type_(type) {
-        switch (type_) {
+    basic_value(dtype type, const Func& func, const Alloc& al = Alloc()) : alloc_type(al), data_(type) {
+        switch (data_.type) {
             case dtype::null: break;
-            case dtype::boolean: func(scalar_variant_t<bool>{}, (value_.b = false)); break;
-            case dtype::integer: func(scalar_variant_t<std::int32_t>{}, (value_.i = 0)); break;
-            case dtype::unsigned_integer: func(scalar_variant_t<std::uint32_t>{}, (value_.u = 0)); break;
-            case dtype::long_integer: func(scalar_variant_t<std::int64_t>{}, (value_.i64 = 0)); break;
-            case dtype::unsigned_long_integer: func(scalar_variant_t<std::uint64_t>{}, (value_.u64 = 0)); break;
-            case dtype::double_precision: func(scalar_variant_t<double>{}, (value_.dbl = 0)); break;
+            case dtype::boolean: func(scalar_variant_t<bool>{}, (data_.value.b = false)); break;
+            case dtype::integer: func(scalar_variant_t<std::int32_t>{}, (data_.value.i = 0)); break;
+            case dtype::unsigned_integer: func(scalar_variant_t<std::uint32_t>{}, (data_.value.u = 0)); break;
+            case dtype::long_integer: func(scalar_variant_t<std::int64_t>{}, (data_.value.i64 = 0)); break;
+            case dtype::unsigned_long_integer: func(scalar_variant_t<std::uint64_t>{}, (data_.value.u64 = 0)); break;
+            case dtype::double_precision: func(scalar_variant_t<double>{}, (data_.value.dbl = 0)); break;
             case dtype::string: {
-                value_.str.construct();
+                init_sso();
                 func(string_variant_t{}, *this);
             } break;
             case dtype::array: {
-                value_.arr.construct();
+                data_.value.arr.construct();
                 func(array_variant_t{}, *this);
             } break;
             case dtype::record: {
                 typename record_t::alloc_type rec_al(*this);
-                value_.rec.construct(rec_al);
+                data_.value.rec.construct(rec_al);
                 func(record_variant_t{}, *this);
             } break;
             default: UXS_UNREACHABLE_CODE;
@@ -902,36 +1299,39 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     }
 
     ~basic_value() {
-        if (type_ != dtype::null) { destroy(); }
+        if (data_.type != dtype::null) { destroy(); }
     }
 
-    basic_value(const basic_value& other) noexcept(std::is_nothrow_default_constructible<alloc_type>::value)
-        : alloc_type(), type_(other.type_) {
+    basic_value(const basic_value& other) noexcept
+        : alloc_type(std::allocator_traits<alloc_type>::select_on_container_copy_construction(other)),
+          data_(other.data_.type) {
         init_from(other);
     }
-    basic_value(const basic_value& other, const Alloc& al) noexcept : alloc_type(al), type_(other.type_) {
+    basic_value(const basic_value& other, const Alloc& al) noexcept : alloc_type(al), data_(other.data_.type) {
         init_from(other);
     }
     basic_value& operator=(const basic_value& other) noexcept {
         if (&other == this) { return *this; }
-        if (type_ != dtype::null) { destroy(); }
-        type_ = other.type_;
+        if (data_.type != dtype::null) { destroy(); }
+        data_.type = other.data_.type;
         init_from(other);
         return *this;
     }
 
-    basic_value(basic_value&& other) noexcept : alloc_type(std::move(other)), type_(other.type_), value_(other.value_) {
-        other.type_ = dtype::null;
+    basic_value(basic_value&& other) noexcept : alloc_type(std::move(other)), data_(other.data_.type) {
+        copy_storage(other);
+        other.data_.type = dtype::null;
     }
-    basic_value(basic_value&& other, const Alloc& al) noexcept : alloc_type(al), type_(other.type_) {
+    basic_value(basic_value&& other, const Alloc& al) noexcept : alloc_type(al), data_(other.data_.type) {
         move_construct_impl(std::move(other), is_alloc_always_equal<alloc_type>());
     }
     basic_value& operator=(basic_value&& other) noexcept {
         if (&other == this) { return *this; }
-        if (type_ != dtype::null) { destroy(); }
+        if (data_.type != dtype::null) { destroy(); }
         alloc_type::operator=(std::move(other));
-        type_ = other.type_, value_ = other.value_;
-        other.type_ = dtype::null;
+        data_.type = other.data_.type;
+        copy_storage(other);
+        other.data_.type = dtype::null;
         return *this;
     }
 
@@ -955,15 +1355,15 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     UXS_EXPORT void assign(record_variant_t, std::initializer_list<std::pair<key_type, basic_value>> init);
 
 #define UXS_DB_VALUE_IMPLEMENT_SCALAR_INIT(ty, id, field) \
-    basic_value(ty v) noexcept(std::is_nothrow_default_constructible<alloc_type>::value) : alloc_type(), type_(id) { \
-        value_.field = static_cast<decltype(value_.field)>(v); \
+    basic_value(ty v) noexcept(std::is_nothrow_default_constructible<alloc_type>::value) : alloc_type(), data_(id) { \
+        data_.value.field = static_cast<decltype(data_.value.field)>(v); \
     } \
-    basic_value(ty v, const Alloc& al) noexcept : alloc_type(al), type_(id) { \
-        value_.field = static_cast<decltype(value_.field)>(v); \
+    basic_value(ty v, const Alloc& al) noexcept : alloc_type(al), data_(id) { \
+        data_.value.field = static_cast<decltype(data_.value.field)>(v); \
     } \
     basic_value& operator=(ty v) noexcept { \
-        if (type_ != dtype::null) { destroy(); } \
-        type_ = id, value_.field = static_cast<decltype(value_.field)>(v); \
+        if (data_.type != dtype::null) { destroy(); } \
+        data_.type = id, data_.value.field = static_cast<decltype(data_.value.field)>(v); \
         return *this; \
     }
     UXS_DB_VALUE_IMPLEMENT_SCALAR_INIT(bool, dtype::boolean, b)
@@ -987,16 +1387,16 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     basic_value& operator=(const char_type* cstr) { return (*this = std::basic_string_view<char_type>(cstr)); }
 
     basic_value& operator=(std::nullptr_t) noexcept {
-        if (type_ == dtype::null) { return *this; }
+        if (data_.type == dtype::null) { return *this; }
         destroy();
         return *this;
     }
 
     void swap(basic_value& other) noexcept {
         if (&other == this) { return; }
-        std::swap(static_cast<alloc_type&>(*this), static_cast<alloc_type&>(other));
-        std::swap(value_, other.value_);
-        std::swap(type_, other.type_);
+        basic_value tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
     }
 
     UXS_EXPORT void string_reserve(std::size_t sz);
@@ -1011,7 +1411,17 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     template<typename CharT_, typename Alloc_>
     friend bool operator!=(const basic_value<CharT_, Alloc_>& lhs, const basic_value<CharT_, Alloc_>& rhs) noexcept;
 
-    dtype type() const noexcept { return type_; }
+    // Structural hash: equal values have equal hashes, and records with the same items in other order too
+    UXS_EXPORT std::size_t hash() const noexcept;
+
+    // Returns `true` if both values are arrays or records with the same copy-on-write storage, so they are equal
+    bool shares_storage_with(const basic_value& other) const noexcept {
+        if (data_.type != other.data_.type) { return false; }
+        if (data_.type == dtype::array) { return data_.value.arr.shares_storage_with(other.data_.value.arr); }
+        return data_.type == dtype::record && data_.value.rec.shares_storage_with(other.data_.value.rec);
+    }
+
+    dtype type() const noexcept { return data_.type; }
     allocator_type get_allocator() const noexcept { return allocator_type(*this); }
 
     template<typename Ty>
@@ -1074,18 +1484,18 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
         return it != end() ? it.value() : basic_value();
     }
 
-    bool is_null() const noexcept { return type_ == dtype::null; }
-    bool is_bool() const noexcept { return type_ == dtype::boolean; }
+    bool is_null() const noexcept { return data_.type == dtype::null; }
+    bool is_bool() const noexcept { return data_.type == dtype::boolean; }
     UXS_EXPORT bool is_int() const noexcept;
     UXS_EXPORT bool is_uint() const noexcept;
     UXS_EXPORT bool is_int64() const noexcept;
     UXS_EXPORT bool is_uint64() const noexcept;
     UXS_EXPORT bool is_integral() const noexcept;
     bool is_double() const noexcept { return is_numeric(); }
-    bool is_numeric() const noexcept { return type_ >= dtype::integer && type_ <= dtype::double_precision; }
-    bool is_string() const noexcept { return type_ == dtype::string; }
-    bool is_array() const noexcept { return type_ == dtype::array; }
-    bool is_record() const noexcept { return type_ == dtype::record; }
+    bool is_numeric() const noexcept { return data_.type >= dtype::integer && data_.type <= dtype::double_precision; }
+    bool is_string() const noexcept { return data_.type == dtype::string; }
+    bool is_array() const noexcept { return data_.type == dtype::array; }
+    bool is_record() const noexcept { return data_.type == dtype::record; }
 
     bool as_bool() const;
     std::int32_t as_int() const;
@@ -1096,12 +1506,12 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     std::basic_string<char_type> as_string() const;
 
     std::basic_string_view<char_type> as_string_view() const {
-        if (type_ == dtype::string) { return value_.str.cview(); }
+        if (data_.type == dtype::string) { return str_view(); }
         throw database_error("bad value conversion");
     }
 
     const char_type* as_c_string() const {
-        if (type_ == dtype::string) { return value_.str.c_str(); }
+        if (data_.type == dtype::string) { return str_c_str(); }
         throw database_error("bad value conversion");
     }
 
@@ -1113,9 +1523,9 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     UXS_EXPORT est::optional<double> get_double() const;
     UXS_EXPORT est::optional<std::basic_string<char_type>> get_string() const;
     est::optional<std::basic_string_view<char_type>> get_string_view() const {
-        return type_ == dtype::string ? est::make_optional(value_.str.cview()) : est::nullopt();
+        return data_.type == dtype::string ? est::make_optional(str_view()) : est::nullopt();
     }
-    const char_type* get_c_string() const { return type_ == dtype::string ? value_.str.c_str() : nullptr; }
+    const char_type* get_c_string() const { return data_.type == dtype::string ? str_c_str() : nullptr; }
 
     bool empty() const noexcept { return size() == 0; }
     UXS_EXPORT std::size_t size() const noexcept;
@@ -1183,17 +1593,17 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
 
     template<typename Func>
     auto visit(const Func& func) const -> decltype(func(nullptr)) {
-        switch (type_) {
+        switch (data_.type) {
             case dtype::null: return func(nullptr);
-            case dtype::boolean: return func(value_.b);
-            case dtype::integer: return func(value_.i);
-            case dtype::unsigned_integer: return func(value_.u);
-            case dtype::long_integer: return func(value_.i64);
-            case dtype::unsigned_long_integer: return func(value_.u64);
-            case dtype::double_precision: return func(value_.dbl);
-            case dtype::string: return func(value_.str.cview());
-            case dtype::array: return func(value_.arr.cview());
-            case dtype::record: return func(value_.rec.crange());
+            case dtype::boolean: return func(data_.value.b);
+            case dtype::integer: return func(data_.value.i);
+            case dtype::unsigned_integer: return func(data_.value.u);
+            case dtype::long_integer: return func(data_.value.i64);
+            case dtype::unsigned_long_integer: return func(data_.value.u64);
+            case dtype::double_precision: return func(data_.value.dbl);
+            case dtype::string: return func(str_view());
+            case dtype::array: return func(data_.value.arr.cview());
+            case dtype::record: return func(data_.value.rec.crange());
             default: UXS_UNREACHABLE_CODE;
         }
     }
@@ -1201,10 +1611,14 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     UXS_EXPORT const_iterator find(key_type key) const noexcept;
     UXS_EXPORT iterator find(key_type key);
     bool contains(key_type key) const noexcept { return find(key) != end(); }
-    std::size_t count(key_type key) const noexcept { return type_ == dtype::record ? value_.rec.count(key) : 0; }
+    std::size_t count(key_type key) const noexcept {
+        return data_.type == dtype::record ? data_.value.rec.count(key) : 0;
+    }
 
     UXS_EXPORT void clear();
     UXS_EXPORT void make_unique();
+    UXS_EXPORT bool is_unique() const noexcept;
+    UXS_EXPORT value_memory_usage memory_usage() const;
     UXS_EXPORT void reserve(std::size_t sz);
     UXS_EXPORT void resize(std::size_t sz);
     UXS_EXPORT void resize(std::size_t sz, const basic_value& v);
@@ -1243,22 +1657,45 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     UXS_EXPORT iterator erase(const_iterator it);
     UXS_EXPORT std::size_t erase(key_type key);
 
+    // Makes the record share its key set with other records having the same keys in the same order. Values of such
+    // a record are kept together and looked up through the shared index, until its key set is changed. Both changes
+    // of representation invalidate references to record items
+    UXS_EXPORT void share_keys(basic_shape_table<CharT, Alloc>& shapes);
+
  private:
     friend class detail::record_t<CharT, Alloc>;
 
-    dtype type_;
+    struct data_storage_t {
+        explicit data_storage_t(dtype t) noexcept : type(t) {}
+        dtype type;
+        std::uint8_t sso_size;
+        union {
+            bool b;
+            std::int32_t i;
+            std::uint32_t u;
+            std::int64_t i64;
+            std::uint64_t u64;
+            double dbl;
+            char_array_t str;
+            value_array_t arr;
+            record_t rec;
+        } value;
+    };
+
+    enum : unsigned { sso_capacity = (sizeof(data_storage_t) - 2) / sizeof(CharT) - 1, sso_heap = 0xff };
 
+    struct sso_storage_t {
+        dtype type;
+        std::uint8_t size;
+        char_type chars[sso_capacity + 1];
+    };
+
+    // Both representations start with the type: short strings are kept inline in `sso_`, and for all other values
+    // `data_` is active; `data_.sso_size` of a long string is `sso_heap`, and `data_.value.str` is used
     union {
-        bool b;
-        std::int32_t i;
-        std::uint32_t u;
-        std::int64_t i64;
-        std::uint64_t u64;
-        double dbl;
-        char_array_t str;
-        value_array_t arr;
-        record_t rec;
-    } value_;
+        data_storage_t data_;
+        sso_storage_t sso_;
+    };
 
     UXS_EXPORT void init_from(const basic_value& other) noexcept;
     UXS_EXPORT void destroy() noexcept;
@@ -1267,15 +1704,49 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
     UXS_EXPORT void init_as_record();
     UXS_EXPORT void convert_to_array();
 
+    void copy_storage(const basic_value& other) noexcept {
+        if (other.data_.type == dtype::string && other.is_sso()) { return assign_sso(other.str_view()); }
+        data_ = other.data_;
+    }
+
+    bool is_sso() const noexcept { return data_.sso_size != sso_heap; }
+    std::basic_string_view<char_type> str_view() const noexcept {
+        return is_sso() ? std::basic_string_view<char_type>(sso_.chars, sso_.size) : data_.value.str.cview();
+    }
+    const char_type* str_c_str() const noexcept { return is_sso() ? sso_.chars : data_.value.str.c_str(); }
+
+    void init_sso() noexcept {
+        static_assert(sizeof(sso_storage_t) == sizeof(data_storage_t) && sso_capacity < sso_heap,
+                      "unexpected value layout");
+        sso_.type = dtype::string, sso_.size = 0, sso_.chars[0] = '\0';
+    }
+
+    void assign_sso(std::basic_string_view<char_type> s) noexcept {
+        sso_.type = dtype::string;
+        std::char_traits<char_type>::move(sso_.chars, s.data(), s.size());
+        sso_.chars[s.size()] = '\0';
+        sso_.size = static_cast<std::uint8_t>(s.size());
+    }
+
+    void construct_string(std::basic_string_view<char_type> s) {
+        if (s.size() <= sso_capacity) { return assign_sso(s); }
+        typename char_array_t::alloc_type str_al(*this);
+        data_.value.str.construct(str_al, s);
+        data_.sso_size = sso_heap;
+    }
+
+    UXS_EXPORT void spill_string(std::size_t cap, std::basic_string_view<char_type> tail);
     void move_construct_impl(basic_value&& other, std::true_type) noexcept {
-        type_ = other.type_, value_ = other.value_;
-        other.type_ = dtype::null;
+        data_.type = other.data_.type;
+        copy_storage(other);
+        other.data_.type = dtype::null;
     }
 
     void move_construct_impl(basic_value&& other, std::false_type) noexcept {
         if (static_cast<alloc_type&>(*this) == static_cast<alloc_type&>(other)) {
-            type_ = other.type_, value_ = other.value_;
-            other.type_ = dtype::null;
+            data_.type = other.data_.type;
+            copy_storage(other);
+            other.data_.type = dtype::null;
         } else {
             init_from(other);
         }
@@ -1287,121 +1758,129 @@ class basic_value : protected std::allocator_traits<Alloc>::template rebind_allo
 template<typename CharT, typename Alloc>
 template<typename InputIt, typename>
 void basic_value<CharT, Alloc>::assign(array_variant_t, InputIt first, InputIt last) {
-    if (type_ != dtype::array) {
-        if (type_ != dtype::null) { destroy(); }
-        value_.arr.construct();
-        type_ = dtype::array;
+    if (data_.type != dtype::array) {
+        if (data_.type != dtype::null) { destroy(); }
+        data_.value.arr.construct();
+        data_.type = dtype::array;
     }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.assign(arr_al, first, last);
+    data_.value.arr.assign(arr_al, first, last);
 }
 
 template<typename CharT, typename Alloc>
 template<typename InputIt, typename>
 void basic_value<CharT, Alloc>::assign(record_variant_t, InputIt first, InputIt last) {
     typename record_t::alloc_type rec_al(*this);
-    if (type_ != dtype::record) {
-        if (type_ != dtype::null) { destroy(); }
-        value_.rec.construct(rec_al, detail::initial_alloc_size(first, last, is_random_access_iterator<InputIt>()));
-        type_ = dtype::record;
+    if (data_.type != dtype::record) {
+        if (data_.type != dtype::null) { destroy(); }
+        data_.value.rec.construct(rec_al,
+                                  detail::initial_alloc_size(first, last, is_random_access_iterator<InputIt>()));
+        data_.type = dtype::record;
     }
-    value_.rec.assign(rec_al, first, last);
+    data_.value.rec.assign(rec_al, first, last);
 }
 
 template<typename CharT, typename Alloc>
 template<typename... Args>
 basic_value<CharT, Alloc>& basic_value<CharT, Alloc>::emplace_back(Args&&... args) {
-    if (type_ != dtype::array) { convert_to_array(); }
+    if (data_.type != dtype::array) { convert_to_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    return value_.arr.emplace_back(arr_al, std::forward<Args>(args)...);
+    return data_.value.arr.emplace_back(arr_al, std::forward<Args>(args)...);
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::pop_back() {
-    if (type_ != dtype::array) { throw database_error("not an array"); }
+    if (data_.type != dtype::array) { throw database_error("not an array"); }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.pop_back(arr_al);
+    data_.value.arr.pop_back(arr_al);
 }
 
 template<typename CharT, typename Alloc>
 template<typename... Args>
 auto basic_value<CharT, Alloc>::emplace(std::size_t pos, Args&&... args) -> iterator {
-    if (type_ != dtype::array) { init_as_array(); }
+    if (data_.type != dtype::array) { init_as_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    basic_value& item = value_.arr.emplace(arr_al, pos, std::forward<Args>(args)...);
-    return iterator(&item, value_.arr.cbegin(), value_.arr.cend());
+    basic_value& item = data_.value.arr.emplace(arr_al, pos, std::forward<Args>(args)...);
+    return iterator(&item, data_.value.arr.cbegin(), data_.value.arr.cend());
 }
 
 template<typename CharT, typename Alloc>
 template<typename... Args>
 auto basic_value<CharT, Alloc>::emplace(key_type key, Args&&... args) -> iterator {
-    if (type_ != dtype::record) { init_as_record(); }
+    if (data_.type != dtype::record) { init_as_record(); }
     typename record_t::alloc_type rec_al(*this);
-    return iterator(value_.rec.emplace(rec_al, key, std::forward<Args>(args)...));
+    auto** pos = data_.value.rec.emplace(rec_al, key, std::forward<Args>(args)...);
+    return iterator(pos, data_.value.rec.cbegin(), data_.value.rec.cend());
 }
 
 template<typename CharT, typename Alloc>
 template<typename... Args>
 auto basic_value<CharT, Alloc>::emplace_unique(key_type key, Args&&... args) -> std::pair<iterator, bool> {
-    if (type_ != dtype::record) { init_as_record(); }
+    if (data_.type != dtype::record) { init_as_record(); }
     typename record_t::alloc_type rec_al(*this);
-    const auto result = value_.rec.emplace_unique(rec_al, key, std::forward<Args>(args)...);
-    return std::make_pair(iterator(result.first), result.second);
+    const auto result = data_.value.rec.emplace_unique(rec_al, key, std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first, data_.value.rec.cbegin(), data_.value.rec.cend()), result.second);
 }
 
 template<typename CharT, typename Alloc>
 template<typename InputIt, typename>
 void basic_value<CharT, Alloc>::insert(std::size_t pos, InputIt first, InputIt last) {
-    if (type_ != dtype::array) { init_as_array(); }
+    if (data_.type != dtype::array) { init_as_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.insert(arr_al, pos, first, last);
+    data_.value.arr.insert(arr_al, pos, first, last);
 }
 
 template<typename CharT, typename Alloc>
 template<typename InputIt, typename>
 void basic_value<CharT, Alloc>::insert(InputIt first, InputIt last) {
     typename record_t::alloc_type rec_al(*this);
-    if (type_ != dtype::record) {
-        if (type_ != dtype::null) { throw database_error("not a record"); }
-        value_.rec.construct(rec_al, detail::initial_alloc_size(first, last, is_random_access_iterator<InputIt>()));
-        type_ = dtype::record;
+    if (data_.type != dtype::record) {
+        if (data_.type != dtype::null) { throw database_error("not a record"); }
+        data_.value.rec.construct(rec_al,
+                                  detail::initial_alloc_size(first, last, is_random_access_iterator<InputIt>()));
+        data_.type = dtype::record;
     }
-    value_.rec.insert(rec_al, first, last);
+    data_.value.rec.insert(rec_al, first, last);
 }
 
 // --------------------------
 
 template<typename CharT, typename Alloc>
 est::span<typename basic_value<CharT, Alloc>::char_type> basic_value<CharT, Alloc>::as_string_span() {
-    if (type_ != dtype::string) { throw database_error("not a string"); }
+    if (data_.type != dtype::string) { throw database_error("not a string"); }
+    if (is_sso()) { return est::as_span(static_cast<char_type*>(sso_.chars), sso_.size); }
     typename char_array_t::alloc_type str_al(*this);
-    return value_.str.view(str_al);
+    return data_.value.str.view(str_al);
 }
 
 template<typename CharT, typename Alloc>
 est::span<const basic_value<CharT, Alloc>> basic_value<CharT, Alloc>::as_array() const noexcept {
-    if (type_ != dtype::array) { return type_ != dtype::null ? est::as_span(this, 1) : est::span<basic_value>(); }
-    return value_.arr.cview();
+    if (data_.type != dtype::array) {
+        return data_.type != dtype::null ? est::as_span(this, 1) : est::span<basic_value>();
+    }
+    return data_.value.arr.cview();
 }
 
 template<typename CharT, typename Alloc>
 est::span<basic_value<CharT, Alloc>> basic_value<CharT, Alloc>::as_array() {
-    if (type_ != dtype::array) { return type_ != dtype::null ? est::as_span(this, 1) : est::span<basic_value>(); }
+    if (data_.type != dtype::array) {
+        return data_.type != dtype::null ? est::as_span(this, 1) : est::span<basic_value>();
+    }
     typename value_array_t::alloc_type arr_al(*this);
-    return value_.arr.view(arr_al);
+    return data_.value.arr.view(arr_al);
 }
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::as_record() const -> iterator_range<const_record_iterator> {
-    if (type_ != dtype::record) { throw database_error("not a record"); }
-    return value_.rec.crange();
+    if (data_.type != dtype::record) { throw database_error("not a record"); }
+    return data_.value.rec.crange();
 }
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::as_record() -> iterator_range<record_iterator> {
-    if (type_ != dtype::record) { throw database_error("not a record"); }
+    if (data_.type != dtype::record) { throw database_error("not a record"); }
     typename record_t::alloc_type rec_al(*this);
-    return value_.rec.range(rec_al);
+    return data_.value.rec.range(rec_al);
 }
 
 // --------------------------
@@ -1455,6 +1934,27 @@ UXS_DB_VALUE_IMPLEMENT_SCALAR_GETTERS(long double, _double)
 UXS_DB_VALUE_IMPLEMENT_SCALAR_GETTERS(std::basic_string<CharT>, _string)
 #undef UXS_DB_VALUE_IMPLEMENT_SCALAR_GETTERS
 
+inline std::size_t hash_mix(std::uint64_t h) noexcept {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;  // splitmix64 finalizer
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<std::size_t>(h ^ (h >> 31));
+}
+
+// Hash of an array or a record with element hashes given by `fn`; record items are combined regardless of order
+template<typename CharT, typename Alloc, typename Func>
+std::size_t container_hash(const basic_value<CharT, Alloc>& x, const Func& fn) {
+    std::uint64_t h = x.size();
+    if (x.is_array()) {
+        for (const auto& el : x.as_array()) { h = hash_mix(h ^ (fn(el) + 0x9e3779b97f4a7c15ull)); }
+        return hash_mix(h + 1);
+    }
+    std::uint64_t sum = 0;
+    for (const auto& item : x.as_record()) {
+        sum += hash_mix(std::hash<std::basic_string_view<CharT>>{}(item.key()) + hash_mix(fn(item.value())));
+    }
+    return hash_mix(h ^ sum);
+}
+
 }  // namespace detail
 
 template<typename CharT, typename Alloc>
@@ -1529,6 +2029,39 @@ basic_value<CharT, Alloc> make_record(
 
 using value = basic_value<char>;
 
+// --------------------------
+
+// Collection of record shapes, which are shared key sets of records; the table keeps at most `max_count` shapes, and
+// shapes stay alive while records referencing them exist
+template<typename CharT, typename Alloc = std::allocator<CharT>>
+class basic_shape_table {
+ public:
+    using shape_t = detail::record_shape<CharT, Alloc>;
+
+    explicit basic_shape_table(std::size_t max_count = 4096, const Alloc& al = Alloc())
+        : al_(al), max_count_(max_count) {}
+    ~basic_shape_table() { clear(); }
+    basic_shape_table(const basic_shape_table&) = delete;
+    basic_shape_table& operator=(const basic_shape_table&) = delete;
+
+    std::size_t size() const noexcept { return shapes_.size(); }
+
+    void clear() noexcept {
+        for (const auto& item : shapes_) { item.second->unref(); }
+        shapes_.clear();
+    }
+
+    // Returns the shape with given keys or `nullptr` if it can't be shared
+    UXS_EXPORT shape_t* get(typename shape_t::node_t* const* nodes, std::size_t count);
+
+ private:
+    typename shape_t::alloc_type al_;
+    std::size_t max_count_;
+    std::unordered_multimap<std::size_t, shape_t*> shapes_;
+};
+
+using shape_table = basic_shape_table<char>;
+
 }  // namespace db
 }  // namespace uxs
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "value.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uxs {
+namespace db {
+
+enum class reclaim_mode { manual = 0, background };
+
+// Value reclaimer destroys retired values apart from the code dropping them: in bounded slices by `collect()` calls,
+// or on its own thread in `background` mode. Arrays and records are taken apart level by level, and long ones in
+// parts, so a slice stays short even for huge trees; arrays and records shared with other values are just released.
+// In `background` mode `Alloc` must be usable from several threads at once
+template<typename CharT, typename Alloc = std::allocator<CharT>>
+class basic_value_reclaimer {
+ public:
+    using value_t = basic_value<CharT, Alloc>;
+
+    UXS_EXPORT explicit basic_value_reclaimer(reclaim_mode mode = reclaim_mode::manual);
+    UXS_EXPORT ~basic_value_reclaimer();
+    basic_value_reclaimer(const basic_value_reclaimer&) = delete;
+    basic_value_reclaimer& operator=(const basic_value_reclaimer&) = delete;
+
+    UXS_EXPORT void retire(value_t&& v);
+
+    // Destroys about `budget` elements of retired values; returns `true` if nothing is left
+    UXS_EXPORT bool collect(std::size_t budget);
+
+    // Waits until all values retired so far are destroyed, or destroys them in `manual` mode
+    UXS_EXPORT void flush();
+
+ private:
+    std::mutex mtx_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;
+    std::vector<value_t> pending_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void run();
+};
+
+using value_reclaimer = basic_value_reclaimer<char>;
+
+}  // namespace db
+}  // namespace uxs
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "uxs/io/iomembuffer.h"
+#include "uxs/memory.h"
 #include "uxs/string_cvt.h"
 
+#include <algorithm>
 #include <forward_list>
-#include <map>
+#include <unordered_set>
+#include <vector>
 
 namespace uxs {
 namespace db {
@@ -40,7 +43,11 @@ struct xml_fmt_opts {
     unsigned indent_size = 2;
 };
 
+class path_filter;
+
 namespace detail {
+class path_matcher;
+
 enum class lex_token_t : int {
     eof = 0,
     eq = '=',
@@ -66,25 +73,111 @@ struct lexer {
     UXS_EXPORT explicit lexer(ibuf& in);
     UXS_EXPORT lex_token_t lex(std::string_view& lval);
 };
+
+// Interned element names: equal names share the same characters, which stay in place while the table lives, so
+// interned names are compared by address. The table is bounded, so element names which don't fit are not interned
+class name_table {
+ public:
+    static const std::size_t max_size = 1024;
+    static const std::size_t max_name_size = 128;
+
+    UXS_EXPORT std::string_view intern(std::string_view name);
+
+    // Returns the interned name, or a view without data if the name is not met yet and the table is full
+    std::string_view try_intern(std::string_view name) {
+        if (size_ < max_size && name.size() <= max_name_size) { return intern(name); }
+        auto it = index_.find(name);
+        return it != index_.end() ? *it : std::string_view();
+    }
+
+    // Returns the interned name, or `name` itself if it is not met yet
+    std::string_view find(std::string_view name) const {
+        auto it = index_.find(name);
+        return it != index_.end() ? *it : name;
+    }
+
+ private:
+    std::forward_list<std::string> names_;
+    std::unordered_set<std::string_view> index_;
+    std::size_t size_ = 0;
+};
+
+// Names of open elements: interned names are kept as views and compared by address, and other names are copied and
+// compared by contents; a name not interned at the start element is not interned at the end element either
+class name_stack {
+ public:
+    bool empty() const noexcept { return items_.empty(); }
+    std::size_t size() const noexcept { return items_.size(); }
+    bool is_interned(std::size_t n) const noexcept { return items_[n].data != nullptr; }
+
+    std::string_view operator[](std::size_t n) const noexcept {
+        const auto& item = items_[n];
+        return std::string_view(item.data ? item.data : chars_.data() + item.offset, item.size);
+    }
+
+    std::string_view back() const noexcept { return (*this)[items_.size() - 1]; }
+
+    bool is_back(std::string_view name) const noexcept {
+        const auto& item = items_.back();
+        return item.data ? item.data == name.data() : back() == name;
+    }
+
+    void clear() noexcept { items_.clear(), chars_.clear(); }
+
+    void push_back(std::string_view name, bool is_interned) {
+        if (is_interned) {
+            items_.push_back(item_t{name.data(), 0, name.size()});
+            return;
+        }
+        items_.push_back(item_t{nullptr, chars_.size(), name.size()});
+        chars_.append(name.data(), name.size());
+    }
+
+    void pop_back() noexcept {
+        if (!items_.back().data) { chars_.resize(items_.back().offset); }
+        items_.pop_back();
+    }
+
+ private:
+    struct item_t {
+        const char* data;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    std::vector<item_t> items_;
+    std::string chars_;
+};
 }  // namespace detail
 
-class attributes_t : public std::map<std::string_view, std::string> {
+// Attributes of the last start element or document declaration in document order. Names and values are copied to
+// a character buffer reused from element to element, so a steady-state parse allocates nothing, and looked up by
+// linear scan
+class attributes_t {
  public:
-    using underlying_t = std::map<std::string_view, std::string>;
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using iterator = const value_type*;
+    using const_iterator = const value_type*;
 
     attributes_t() = default;
-#if __cplusplus < 201703L
-    ~attributes_t() = default;
-    attributes_t(const attributes_t&) = default;
-    attributes_t& operator=(const attributes_t&) = default;
-    attributes_t(attributes_t&& other) noexcept : underlying_t(std::move(other)) {}
-    attributes_t& operator=(attributes_t&& other) noexcept {
-        underlying_t::operator=(std::move(other));
+    attributes_t(const attributes_t& other) { assign(other); }
+    attributes_t& operator=(const attributes_t& other) {
+        if (&other != this) { assign(other); }
         return *this;
     }
-#endif  // __cplusplus < 201703L
+    attributes_t(attributes_t&&) noexcept = default;
+    attributes_t& operator=(attributes_t&&) noexcept = default;
 
-    bool contains(std::string_view key) const { return find(key) != end(); }
+    bool empty() const noexcept { return items_.empty(); }
+    std::size_t size() const noexcept { return items_.size(); }
+    const_iterator begin() const noexcept { return items_.data(); }
+    const_iterator end() const noexcept { return items_.data() + items_.size(); }
+
+    const_iterator find(std::string_view key) const noexcept {
+        return std::find_if(begin(), end(), [key](const value_type& item) { return item.first == key; });
+    }
+
+    bool contains(std::string_view key) const noexcept { return find(key) != end(); }
 
     std::string_view value_or(std::string_view key, std::string_view default_value) const {
         auto it = find(key);
@@ -103,8 +196,72 @@ class attributes_t : public std::map<std::string_view, std::string> {
     Ty value(std::string_view key) const {
         return value_or<Ty>(key, Ty());
     }
+
+    // Adds an attribute unless there is one with the same name
+    UXS_EXPORT std::pair<const_iterator, bool> emplace(std::string_view key, std::string_view value);
+
+    void clear() noexcept {
+        chars_.clear();
+        items_.clear();
+    }
+
+ private:
+    std::vector<char> chars_;
+    std::vector<value_type> items_;
+
+    UXS_EXPORT void assign(const attributes_t& other);
 };
 
+// Selects elements by absolute paths like `/feed/item/price`: steps are element names, and `*` step matches any
+// element name
+class path_filter {
+ public:
+    path_filter() = default;
+    UXS_EXPORT explicit path_filter(std::initializer_list<std::string_view> paths);
+
+    bool empty() const noexcept { return nodes_.size() == 1; }
+
+    UXS_EXPORT void add(std::string_view path);
+
+ private:
+    friend class detail::path_matcher;
+
+    // paths are merged into a tree, where the first node is the document
+    struct node_t {
+        std::string name;
+        std::vector<std::size_t> children;
+        bool is_selected = false;
+    };
+
+    std::vector<node_t> nodes_{node_t{}};
+};
+
+namespace detail {
+enum class path_match : int { none = 0, partial, full };
+
+// Tracks the path of the current element through the filter tree; names of the filter are interned, so they are
+// compared with element names by address
+class path_matcher {
+ public:
+    UXS_EXPORT path_matcher(const path_filter& filter, name_table& names);
+
+    // Returns `full` if the element is selected, `partial` if some of its descendants may be selected, which must be
+    // followed by `leave()` at the end of the element, and `none` otherwise
+    UXS_EXPORT path_match enter(std::string_view name);
+
+    void leave() {
+        active_.resize(levels_.back());
+        levels_.pop_back();
+    }
+
+ private:
+    const path_filter& filter_;
+    std::vector<std::string_view> names_;
+    std::vector<std::size_t> active_;  // filter nodes matching the path of the current element
+    std::vector<std::size_t> levels_;  // where nodes of each level begin in `active_`
+};
+}  // namespace detail
+
 class parser {
  public:
     using value_type = std::pair<token_t, std::string_view>;
@@ -131,6 +288,14 @@ class parser {
     template<typename CharT = char, typename Alloc = std::allocator<CharT>>
     UXS_EXPORT basic_value<CharT, Alloc> read(std::string_view root_element, const Alloc& al = Alloc());
 
+    // Reads the first element selected by the filter or having selected descendants. Only selected elements are read
+    // completely, their ancestors are read as records of selected elements, and other elements are skipped
+    template<typename CharT = char, typename Alloc = std::allocator<CharT>>
+    UXS_EXPORT basic_value<CharT, Alloc> read(const path_filter& filter, const Alloc& al = Alloc());
+
+    // Skips contents of the current start element up to the matching end element
+    UXS_EXPORT void skip_element();
+
     class iterator
         : public iterator_facade<iterator, value_type, std::input_iterator_tag, const value_type&, const value_type*> {
      public:
@@ -171,11 +336,26 @@ class parser {
  private:
     detail::lexer lexer_;
     bool is_end_element_pending_ = false;
-    std::forward_list<std::string> name_cache_;
+    detail::name_table names_;
+    std::string_view name_;
+    std::string plain_name_;  // the name of the last start element if it is not interned
+    std::string attr_name_;
     std::pair<token_t, std::string_view> token_;
     attributes_t attrs_;
+    detail::name_stack skipped_names_;
+
+    bool is_name_interned() const noexcept { return name_.data() != plain_name_.data(); }
+    std::string_view intern_name(std::string_view name) {
+        const auto interned = names_.try_intern(name);
+        if (interned.data()) { return interned; }
+        plain_name_.assign(name.data(), name.size());
+        return plain_name_;
+    }
 
     UXS_EXPORT std::pair<token_t, std::string_view> next_impl();
+
+    template<typename CharT, typename Alloc>
+    basic_value<CharT, Alloc> read_impl(detail::path_matcher* matcher, const Alloc& al);
 };
 
 template<typename CharT, typename ValueCharT, typename Alloc>
@@ -191,6 +371,63 @@ void write(basic_iobuf<CharT>& out, const basic_value<ValueCharT, Alloc>& v,
     write(buf, v, element, opts, indent);
 }
 
+// Writes XML incrementally without building `basic_value`: text and attribute values are escaped, elements with
+// child elements are indented by `opts`, and the rest are kept on one line; element and attribute names are written
+// as is. Only names of open elements are kept, so memory use is bounded by document depth
+template<typename CharT>
+class basic_writer {
+ public:
+    explicit basic_writer(basic_membuffer<CharT>& out, xml_fmt_opts opts = {}, unsigned indent = 0)
+        : out_(out), opts_(opts), indent_(indent) {}
+
+    // Output is buffered directly in `out` buffer, so `out` mustn't be used while the writer is alive
+    explicit basic_writer(basic_iobuf<CharT>& out, xml_fmt_opts opts = {}, unsigned indent = 0)
+        : iobuf_(est::make_unique<basic_iomembuffer<CharT>>(out)), out_(*iobuf_), opts_(opts), indent_(indent) {}
+
+    bool complete() const noexcept { return is_complete_; }
+    void flush() noexcept {
+        if (iobuf_) { iobuf_->flush(); }
+    }
+
+    UXS_EXPORT basic_writer& start_element(std::basic_string_view<CharT> name);
+    UXS_EXPORT basic_writer& attribute(std::basic_string_view<CharT> name, std::basic_string_view<CharT> value);
+    UXS_EXPORT basic_writer& text(std::basic_string_view<CharT> text);
+    basic_writer& text(const CharT* text) { return this->text(std::basic_string_view<CharT>(text)); }
+    UXS_EXPORT basic_writer& end_element();
+
+    // Writes `v` as a complete child element named `name` like `write()` does
+    template<typename ValueCharT, typename Alloc>
+    basic_writer& element(est::type_identity_t<std::basic_string_view<ValueCharT>> name,
+                          const basic_value<ValueCharT, Alloc>& v) {
+        begin_child();
+        write(out_, v, name, opts_, indent_ + static_cast<unsigned>(stack_.size()) * opts_.indent_size);
+        end_child();
+        return *this;
+    }
+
+ private:
+    struct element_t {
+        std::size_t name_offset;
+        bool has_children;
+    };
+
+    std::unique_ptr<basic_iomembuffer<CharT>> iobuf_;
+    basic_membuffer<CharT>& out_;
+    xml_fmt_opts opts_;
+    bool is_tag_open_ = false;
+    bool is_complete_ = false;
+    unsigned indent_ = 0;
+    inline_basic_dynbuffer<element_t, 32> stack_;
+    inline_basic_dynbuffer<CharT, 256> names_;
+
+    UXS_EXPORT void begin_child();
+    void end_child() { is_complete_ = stack_.empty(); }
+    UXS_EXPORT void close_tag();
+};
+
+using writer = basic_writer<char>;
+using wwriter = basic_writer<wchar_t>;
+
 }  // namespace xml
 }  // namespace db
 }  // namespace uxs
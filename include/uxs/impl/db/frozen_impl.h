@@ -0,0 +1,134 @@
+#pragma once
+
+#include "uxs/db/frozen.h"
+
+#include <cstring>
+
+namespace uxs {
+namespace db {
+
+namespace detail {
+template<typename Alloc>
+std::uint64_t frozen_image_size(const basic_value<char, Alloc>& v) {
+    using value_t = basic_value<char, Alloc>;
+    using record_iterator = typename value_t::const_record_iterator;
+
+    struct stack_item_t {
+        const value_t* v;
+        std::size_t index;
+        record_iterator it;
+    };
+
+    std::uint64_t sz = frozen_writer::header_size + sizeof(frozen_slot_t);
+    std::vector<stack_item_t> stack;
+
+    // adds the size of string node, or pushes array or record to the stack
+    const auto visit = [&sz, &stack](const value_t& x) {
+        switch (x.type()) {
+            case dtype::string: sz += frozen_writer::string_size(x.as_string_view().size()); break;
+            case dtype::array: {
+                sz += frozen_writer::array_size(x.size());
+                stack.push_back(stack_item_t{&x, 0, record_iterator()});
+            } break;
+            case dtype::record: {
+                sz += frozen_writer::record_size(x.size());
+                stack.push_back(stack_item_t{&x, 0, x.as_record().begin()});
+            } break;
+            default: break;
+        }
+    };
+
+    visit(v);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.v->is_record()) {
+            if (top.it != top.v->as_record().end()) {
+                sz += frozen_writer::string_size(top.it->key().size());
+                visit((top.it++)->value());
+                continue;
+            }
+        } else {
+            const auto range = top.v->as_array();
+            if (top.index != range.size()) {
+                visit(range[top.index++]);
+                continue;
+            }
+        }
+        stack.pop_back();
+    }
+    return sz;
+}
+}  // namespace detail
+
+template<typename Alloc>
+void freeze(biobuf& out, const basic_value<char, Alloc>& v) {
+    using value_t = basic_value<char, Alloc>;
+    using record_iterator = typename value_t::const_record_iterator;
+
+    struct stack_item_t {
+        const value_t* v;
+        std::size_t index;
+        record_iterator it;
+        std::vector<detail::frozen_entry_t> entries;
+    };
+
+    detail::frozen_writer writer(out, detail::frozen_image_size(v));
+    std::vector<stack_item_t> stack;
+    detail::frozen_slot_t slot{};
+
+    // makes the slot for scalar or string value, or pushes array or record to the stack
+    const auto visit = [&writer, &stack, &slot](const value_t& x) {
+        slot = detail::frozen_slot_t{};
+        slot.type = static_cast<std::uint8_t>(x.type());
+        switch (x.type()) {
+            case dtype::null: break;
+            case dtype::boolean: slot.data = x.as_bool() ? 1 : 0; break;
+            case dtype::integer:
+            case dtype::long_integer: slot.data = static_cast<std::uint64_t>(x.as_int64()); break;
+            case dtype::unsigned_integer:
+            case dtype::unsigned_long_integer: slot.data = x.as_uint64(); break;
+            case dtype::double_precision: {
+                const double f = x.as_double();
+                std::memcpy(&slot.data, &f, sizeof(f));
+            } break;
+            case dtype::string: slot.data = writer.write_string(x.as_string_view()); break;
+            case dtype::array: stack.push_back(stack_item_t{&x, 0, record_iterator(), {}}); return true;
+            case dtype::record: stack.push_back(stack_item_t{&x, 0, x.as_record().begin(), {}}); return true;
+            default: UXS_UNREACHABLE_CODE;
+        }
+        return false;
+    };
+
+    if (visit(v)) {
+        while (true) {
+            auto& top = stack.back();
+            if (top.v->is_record()) {
+                if (top.it != top.v->as_record().end()) {
+                    const auto key = top.it->key();
+                    top.entries.push_back(detail::frozen_entry_t{detail::frozen_key_hash(key), writer.write_string(key),
+                                                                 detail::frozen_slot_t{}});
+                    if (!visit((top.it++)->value())) { top.entries.back().value = slot; }
+                    continue;
+                }
+                slot.data = writer.write_record(top.entries);
+            } else {
+                const auto range = top.v->as_array();
+                if (top.index != range.size()) {
+                    top.entries.push_back(detail::frozen_entry_t{0, 0, detail::frozen_slot_t{}});
+                    if (!visit(range[top.index++])) { top.entries.back().value = slot; }
+                    continue;
+                }
+                slot.data = writer.write_array(top.entries);
+            }
+            slot.type = static_cast<std::uint8_t>(top.v->type());
+            stack.pop_back();
+            if (stack.empty()) { break; }
+            stack.back().entries.back().value = slot;
+        }
+    }
+
+    writer.finish(slot);
+}
+
+}  // namespace db
+}  // namespace uxs
@@ -1,78 +1,143 @@
 #pragma once
 
+#include "uxs/db/char_scan.h"
 #include "uxs/db/json.h"
 #include "uxs/db/value.h"
 
+#include <tuple>
+#include <vector>
+
 namespace uxs {
 namespace db {
 namespace json {
 
 // --------------------------
 
-template<typename CharT, typename Alloc>
-basic_value<CharT, Alloc> read(ibuf& in, const Alloc& al) {
-    static const auto token_to_value = [](token_t tt, std::string_view lval,
+namespace detail {
+template<typename CharT, typename Alloc, typename CloseFunc>
+basic_value<CharT, Alloc> read_value(ibuf& in, const Alloc& al, const CloseFunc& fn_close) {
+    static const auto token_to_value = [](token_t tt, std::string_view lval, const detail::number_t& num,
                                           const Alloc& al) -> basic_value<CharT, Alloc> {
         switch (tt) {
             case token_t::null_value: return {nullptr, al};
             case token_t::true_value: return {true, al};
             case token_t::false_value: return {false, al};
             case token_t::integer_number: {
-                std::uint64_t u64 = 0;
-                if (from_string(lval, u64) != 0) {
-                    if (u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max())) {
-                        return {static_cast<std::int32_t>(u64), al};
-                    }
-                    if (u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::uint32_t>::max())) {
-                        return {static_cast<std::uint32_t>(u64), al};
-                    }
-                    if (u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())) {
-                        return {static_cast<std::int64_t>(u64), al};
-                    }
-                    return {u64, al};
+                if (num.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max())) {
+                    return {static_cast<std::int32_t>(num.u64), al};
+                }
+                if (num.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::uint32_t>::max())) {
+                    return {static_cast<std::uint32_t>(num.u64), al};
+                }
+                if (num.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max())) {
+                    return {static_cast<std::int64_t>(num.u64), al};
                 }
-                // too big integer - treat as double
-                return {from_string<double>(lval), al};
+                return {num.u64, al};
             } break;
             case token_t::negative_integer_number: {
-                std::int64_t i64 = 0;
-                if (from_string(lval, i64) != 0) {
-                    if (i64 >= static_cast<std::int64_t>(std::numeric_limits<std::int32_t>::min())) {
-                        return {static_cast<std::int32_t>(i64), al};
-                    }
-                    return {i64, al};
+                if (num.i64 >= static_cast<std::int64_t>(std::numeric_limits<std::int32_t>::min())) {
+                    return {static_cast<std::int32_t>(num.i64), al};
                 }
-                // too big integer - treat as double
-                return {from_string<double>(lval), al};
+                return {num.i64, al};
             } break;
-            case token_t::floating_point_number: return {from_string<double>(lval), al};
+            case token_t::floating_point_number: return {num.dbl, al};
             case token_t::string: return {utf_string_adapter<CharT>{}(lval), al};
             default: UXS_UNREACHABLE_CODE;
         }
     };
 
-    basic_value<CharT, Alloc> result(al);
-    inline_basic_dynbuffer<basic_value<CharT, Alloc>*, 32> stack;
+    // Elements of open arrays and fields of open records are collected in `items` and `fields`, and each container
+    // is made of exact size when it is closed, so containers don't grow while reading. A value being read is at `val`,
+    // which is `result` or the last element or field, and `val_pos` is its place. Keys of open records are kept in
+    // `keys`, and the scratch storage doesn't use `al`, so it isn't charged for reading
+    struct stack_item_t {
+        std::size_t val_pos;    // the place of the container in the enclosing one, or `npos` for `result`
+        std::size_t first;      // the first element or field of the container
+        std::size_t first_key;  // the first key character of a record, or `npos` for arrays
+    };
+
+    using value_t = basic_value<CharT, Alloc>;
+    using key_type = typename value_t::key_type;
+    static const std::size_t npos = ~std::size_t(0);
+
+    value_t result(al);
+    std::vector<value_t> items;
+    std::vector<std::pair<key_type, value_t>> fields;
+    inline_basic_dynbuffer<CharT, 256> keys;
+    inline_basic_dynbuffer<stack_item_t, 32> stack;
+
+    value_t* val = &result;
+    std::size_t val_pos = npos;
+
+    const auto close = [&al, &result, &items, &fields, &keys, &stack, &fn_close] {
+        const stack_item_t top = stack.back();
+        stack.pop_back();
+        value_t& v = top.val_pos == npos ? result :
+                     stack.back().first_key == npos ? items[top.val_pos] : fields[top.val_pos].second;
+        if (top.first_key == npos) {
+            v.assign(array_variant_t{}, std::make_move_iterator(items.begin() + top.first),
+                     std::make_move_iterator(items.end()));
+            items.erase(items.begin() + top.first, items.end());
+        } else {
+            // keys are bound to their characters when no more keys are added
+            const CharT* key = keys.data() + top.first_key;
+            for (auto it = fields.begin() + top.first; it != fields.end(); ++it) {
+                it->first = key_type(key, it->first.size());
+                key += it->first.size();
+            }
+            v = value_t(record_variant_t{}, std::make_move_iterator(fields.begin() + top.first),
+                        std::make_move_iterator(fields.end()), al);
+            fields.erase(fields.begin() + top.first, fields.end());
+            keys.setsize(top.first_key);
+        }
+        fn_close(v);
+    };
 
-    auto* val = &result;
     read(
         in,
-        [&al, &stack, &val](token_t tt, std::string_view lval) {
+        [&al, &items, &fields, &keys, &stack, &val, &val_pos](token_t tt, std::string_view lval,
+                                                               const detail::number_t& num) {
             if (tt >= token_t::null_value) {
-                *val = token_to_value(tt, lval, al);
+                *val = token_to_value(tt, lval, num, al);
+            } else if (tt == token_t::array) {
+                stack.push_back(stack_item_t{val_pos, items.size(), npos});
             } else {
-                *val = tt == token_t::array ? make_array<CharT>(al) : make_record<CharT>(al);
-                stack.push_back(val);
+                stack.push_back(stack_item_t{val_pos, fields.size(), keys.size()});
             }
             return parse_step::into;
         },
-        [&al, &stack, &val]() { val = &stack.back()->emplace_back(al); },
-        [&al, &stack, &val](std::string_view lval) {
-            val = &stack.back()->emplace(utf_string_adapter<CharT>{}(lval), al).value();
+        [&al, &items, &val, &val_pos]() {
+            val_pos = items.size();
+            items.emplace_back(al);
+            val = &items.back();
+        },
+        [&al, &fields, &keys, &val, &val_pos](std::string_view lval) {
+            const auto key = utf_string_adapter<CharT>{}(lval);
+            const std::size_t key_sz = key_type(key).size();
+            keys += key_type(key);
+            val_pos = fields.size();
+            fields.emplace_back(std::piecewise_construct, std::forward_as_tuple(keys.endp() - key_sz, key_sz),
+                                std::forward_as_tuple(al));
+            val = &fields.back().second;
         },
-        [&stack] { stack.pop_back(); });
+        close);
+    // the outermost array or record isn't closed by the parser
+    if (!stack.empty()) { close(); }
     return result;
 }
+}  // namespace detail
+
+template<typename CharT, typename Alloc>
+basic_value<CharT, Alloc> read(ibuf& in, const Alloc& al) {
+    return detail::read_value<CharT>(in, al, [](basic_value<CharT, Alloc>&) {});
+}
+
+template<typename CharT, typename Alloc>
+basic_value<CharT, Alloc> read(ibuf& in, basic_shape_table<CharT, Alloc>& shapes, const Alloc& al) {
+    return detail::read_value<CharT>(in, al, [&shapes](basic_value<CharT, Alloc>& v) {
+        if (v.is_record()) { v.share_keys(shapes); }
+    });
+}
 
 // --------------------------
 
@@ -104,37 +169,42 @@ struct writer_stack_item_t {
     };
 };
 
+template<typename CharT>
+const CharT* find_escaped_char(const CharT* first, const CharT* last) {
+    return std::find_if(first, last, [](CharT ch) {
+        return ch == '\"' || ch == '\\' || static_cast<typename std::make_unsigned<CharT>::type>(ch) < 32;
+    });
+}
+
+inline const char* find_escaped_char(const char* first, const char* last) {
+    return db::detail::find_json_escape(first, last);
+}
+
 template<typename CharT>
 basic_membuffer<CharT>& write_text(basic_membuffer<CharT>& out, std::basic_string_view<CharT> text) {
-    auto it0 = text.begin();
+    const CharT* it0 = text.data();
+    const CharT* last = it0 + text.size();
     out += '\"';
-    for (auto it = it0; it != text.end(); ++it) {
-        char esc = '\0';
+    for (const CharT* it = find_escaped_char(it0, last); it != last; it = find_escaped_char(it0, last)) {
+        out += to_string_view(it0, it);
+        out += '\\';
         switch (*it) {
-            case '\"': esc = '\"'; break;
-            case '\\': esc = '\\'; break;
-            case '\b': esc = 'b'; break;
-            case '\f': esc = 'f'; break;
-            case '\n': esc = 'n'; break;
-            case '\r': esc = 'r'; break;
-            case '\t': esc = 't'; break;
+            case '\"': out += '\"'; break;
+            case '\\': out += '\\'; break;
+            case '\b': out += 'b'; break;
+            case '\f': out += 'f'; break;
+            case '\n': out += 'n'; break;
+            case '\r': out += 'r'; break;
+            case '\t': out += 't'; break;
             default: {
-                if (static_cast<unsigned char>(*it) < 32) {
-                    out += to_string_view(it0, it);
-                    out += string_literal<CharT, '\\', 'u', '0', '0'>{}();
-                    out += '0' + (*it >> 4);
-                    out += "0123456789ABCDEF"[*it & 15];
-                    it0 = it + 1;
-                }
-                continue;
+                out += string_literal<CharT, 'u', '0', '0'>{}();
+                out += '0' + (*it >> 4);
+                out += "0123456789ABCDEF"[*it & 15];
             } break;
         }
-        out += to_string_view(it0, it);
-        out += '\\';
-        out += esc;
         it0 = it + 1;
     }
-    out += to_string_view(it0, text.end());
+    out += to_string_view(it0, last);
     out += '\"';
     return out;
 }
@@ -295,6 +365,129 @@ loop:
     if (!stack.empty()) { goto loop; }
 }
 
+// --------------------------
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::begin_array() {
+    begin_value();
+    out_ += '[';
+    stack_.push_back('[');
+    is_first_element_ = true;
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::end_array() {
+    end_container('[', ']');
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::begin_object() {
+    begin_value();
+    out_ += '{';
+    stack_.push_back('{');
+    is_first_element_ = true;
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::end_object() {
+    end_container('{', '}');
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::key(std::basic_string_view<CharT> k) {
+    if (stack_.empty() || stack_.back() != '{' || has_key_) { throw database_error("unexpected JSON object key"); }
+    write_separator(opts_.object_ws_char);
+    detail::write_text<CharT>(out_, k);
+    if (is_formatted_) {
+        out_ += string_literal<CharT, ':', ' '>{}();
+    } else {
+        out_ += ':';
+    }
+    has_key_ = true;
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::value(std::nullptr_t) {
+    begin_value();
+    out_ += string_literal<CharT, 'n', 'u', 'l', 'l'>{}();
+    end_value();
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::value(bool b) {
+    begin_value();
+    out_ += b ? string_literal<CharT, 't', 'r', 'u', 'e'>{}() : string_literal<CharT, 'f', 'a', 'l', 's', 'e'>{}();
+    end_value();
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::value(double f) {
+    begin_value();
+    to_basic_string(out_, f, fmt_opts{fmt_flags::json_compat});
+    end_value();
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::value(std::basic_string_view<CharT> s) {
+    begin_value();
+    detail::write_text<CharT>(out_, s);
+    end_value();
+    return *this;
+}
+
+template<typename CharT>
+void basic_writer<CharT>::begin_value() {
+    if (stack_.empty()) {
+        if (is_complete_) { throw database_error("JSON value is already complete"); }
+    } else if (stack_.back() == '{') {
+        if (!has_key_) { throw database_error("expected JSON object key"); }
+        has_key_ = false;
+    } else {
+        write_separator(opts_.array_ws_char);
+    }
+}
+
+template<typename CharT>
+void basic_writer<CharT>::write_separator(char ws_char) {
+    if (is_first_element_) {
+        if (is_formatted_ && ws_char == '\n') {
+            out_ += '\n';
+            indent_ += opts_.indent_size;
+            out_.append(indent_, opts_.indent_char);
+        }
+    } else {
+        out_ += ',';
+        if (is_formatted_) {
+            out_ += ws_char;
+            if (ws_char == '\n') { out_.append(indent_, opts_.indent_char); }
+        }
+    }
+}
+
+template<typename CharT>
+void basic_writer<CharT>::end_container(char open_char, char close_char) {
+    if (stack_.empty() || stack_.back() != open_char || has_key_) {
+        throw database_error(std::string("unexpected `") + close_char + '`');
+    }
+    const char ws_char = open_char == '{' ? opts_.object_ws_char : opts_.array_ws_char;
+    if (is_formatted_ && ws_char == '\n' && !is_first_element_) {
+        out_ += '\n';
+        indent_ -= opts_.indent_size;
+        out_.append(indent_, opts_.indent_char);
+    }
+    out_ += close_char;
+    stack_.pop_back();
+    end_value();
+}
+
 }  // namespace json
 }  // namespace db
 }  // namespace uxs
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "uxs/db/json_patch.h"
+#include "uxs/string_util.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace uxs {
+namespace db {
+namespace json {
+
+namespace detail {
+
+template<typename CharT, typename Alloc>
+class patch_maker {
+ public:
+    using value_t = basic_value<CharT, Alloc>;
+    using string_view_type = std::basic_string_view<CharT>;
+
+    explicit patch_maker(const Alloc& al) : patch_(make_array<CharT>(al)) {}
+
+    value_t& patch() noexcept { return patch_; }
+
+    void diff(const value_t& a, const value_t& b) {
+        if (a.shares_storage_with(b)) { return; }
+        if (a.is_array() && b.is_array()) { return diff_arrays(a.as_array(), b.as_array()); }
+        if (a.is_record() && b.is_record()) { return diff_records(a, b); }
+        if (a != b) { add_op(string_literal<CharT, 'r', 'e', 'p', 'l', 'a', 'c', 'e'>{}, &b); }
+    }
+
+ private:
+    value_t patch_;
+    std::basic_string<CharT> path_;
+    std::unordered_map<const value_t*, std::size_t> hashes_;  // hashes of visited arrays and records
+
+    std::size_t hash(const value_t& x) {
+        if (!x.is_array() && !x.is_record()) { return x.hash(); }
+        const auto it = hashes_.find(&x);
+        if (it != hashes_.end()) { return it->second; }
+        const std::size_t h = db::detail::container_hash(x, [this](const value_t& el) { return hash(el); });
+        hashes_.emplace(&x, h);
+        return h;
+    }
+
+    static bool equal(const value_t& a, const value_t& b) { return a.shares_storage_with(b) || a == b; }
+
+    void push_index(std::size_t i) {
+        path_ += '/';
+        std::basic_string<CharT> digits;
+        do { digits += static_cast<CharT>('0' + i % 10); } while (i /= 10);
+        path_.append(digits.rbegin(), digits.rend());
+    }
+
+    void push_key(string_view_type key) {
+        path_ += '/';
+        for (const CharT ch : key) {
+            if (ch == '~') {
+                path_ += '~', path_ += '0';
+            } else if (ch == '/') {
+                path_ += '~', path_ += '1';
+            } else {
+                path_ += ch;
+            }
+        }
+    }
+
+    void add_op(string_view_type op, const value_t* v) {
+        value_t& item = patch_.emplace_back(make_record<CharT>(patch_.get_allocator()));
+        item.emplace(string_literal<CharT, 'o', 'p'>{}, op);
+        item.emplace(string_literal<CharT, 'p', 'a', 't', 'h'>{}, string_view_type(path_));
+        if (v) { item.emplace(string_literal<CharT, 'v', 'a', 'l', 'u', 'e'>{}, *v); }
+    }
+
+    void diff_arrays(est::span<const value_t> lhs, est::span<const value_t> rhs) {
+        std::size_t first = 0, lhs_last = lhs.size(), rhs_last = rhs.size();
+        while (first < lhs_last && first < rhs_last && equal(lhs[first], rhs[first])) { ++first; }
+        while (first < lhs_last && first < rhs_last && equal(lhs[lhs_last - 1], rhs[rhs_last - 1])) {
+            --lhs_last, --rhs_last;
+        }
+        std::size_t i = first, j = first, pos = first;
+        if (i < lhs_last && j < rhs_last) {
+            for (const auto& anchor : match_unique(lhs, rhs, first, lhs_last, rhs_last)) {
+                diff_range(lhs, i, anchor.first, rhs, j, anchor.second, pos);
+                i = anchor.first + 1, j = anchor.second + 1, ++pos;
+            }
+        }
+        diff_range(lhs, i, lhs_last, rhs, j, rhs_last, pos);
+    }
+
+    // Returns positions of elements, which are unique on both sides, equal and in the same relative order; they
+    // are found by hashes and make the longest increasing sequence of positions on the right side
+    std::vector<std::pair<std::size_t, std::size_t>> match_unique(est::span<const value_t> lhs,
+                                                                  est::span<const value_t> rhs, std::size_t first,
+                                                                  std::size_t lhs_last, std::size_t rhs_last) {
+        struct occurrence_t {
+            std::size_t lhs_count = 0, lhs_pos = 0;
+            std::size_t rhs_count = 0, rhs_pos = 0;
+        };
+
+        std::unordered_map<std::size_t, occurrence_t> occurrences;
+        for (std::size_t i = first; i < lhs_last; ++i) {
+            auto& occ = occurrences[hash(lhs[i])];
+            ++occ.lhs_count, occ.lhs_pos = i;
+        }
+        for (std::size_t j = first; j < rhs_last; ++j) {
+            const auto it = occurrences.find(hash(rhs[j]));
+            if (it != occurrences.end()) { ++it->second.rhs_count, it->second.rhs_pos = j; }
+        }
+
+        std::vector<std::pair<std::size_t, std::size_t>> pairs;
+        for (std::size_t i = first; i < lhs_last; ++i) {
+            const auto& occ = occurrences[hash(lhs[i])];
+            if (occ.lhs_count == 1 && occ.rhs_count == 1 && lhs[i] == rhs[occ.rhs_pos]) {
+                pairs.emplace_back(i, occ.rhs_pos);
+            }
+        }
+
+        // patience sorting: `tails[k]` is the pair ending the best increasing sequence of length `k + 1`
+        std::vector<std::size_t> tails, prev(pairs.size());
+        for (std::size_t k = 0; k < pairs.size(); ++k) {
+            const auto it = std::lower_bound(tails.begin(), tails.end(), pairs[k].second,
+                                             [&pairs](std::size_t n, std::size_t j) { return pairs[n].second < j; });
+            prev[k] = it != tails.begin() ? *(it - 1) : pairs.size();
+            if (it != tails.end()) {
+                *it = k;
+            } else {
+                tails.push_back(k);
+            }
+        }
+
+        std::vector<std::pair<std::size_t, std::size_t>> anchors(tails.size());
+        for (std::size_t k = tails.empty() ? pairs.size() : tails.back(), n = anchors.size(); n > 0; k = prev[k]) {
+            anchors[--n] = pairs[k];
+        }
+        return anchors;
+    }
+
+    // Makes `lhs[i, lhs_last)` at position `pos` of the array being patched equal to `rhs[j, rhs_last)`
+    void diff_range(est::span<const value_t> lhs, std::size_t i, std::size_t lhs_last, est::span<const value_t> rhs,
+                    std::size_t j, std::size_t rhs_last, std::size_t& pos) {
+        const std::size_t path_sz = path_.size();
+        for (; i < lhs_last && j < rhs_last; ++i, ++j, ++pos) {
+            push_index(pos);
+            diff(lhs[i], rhs[j]);
+            path_.resize(path_sz);
+        }
+        for (std::size_t n = lhs_last - i; n > 0; --n) {
+            push_index(pos + n - 1);
+            add_op(string_literal<CharT, 'r', 'e', 'm', 'o', 'v', 'e'>{}, nullptr);
+            path_.resize(path_sz);
+        }
+        for (; j < rhs_last; ++j, ++pos) {
+            push_index(pos);
+            add_op(string_literal<CharT, 'a', 'd', 'd'>{}, &rhs[j]);
+            path_.resize(path_sz);
+        }
+    }
+
+    void diff_records(const value_t& a, const value_t& b) {
+        const std::size_t path_sz = path_.size();
+        for (const auto& item : a.as_record()) {
+            if (&a.find(item.key()).value() != &item.value()) { continue; }  // duplicate key
+            const auto it = b.find(item.key());
+            push_key(item.key());
+            if (it == b.end()) {
+                add_op(string_literal<CharT, 'r', 'e', 'm', 'o', 'v', 'e'>{}, nullptr);
+            } else {
+                diff(item.value(), it.value());
+            }
+            path_.resize(path_sz);
+        }
+        for (const auto& item : b.as_record()) {
+            if (a.contains(item.key()) || &b.find(item.key()).value() != &item.value()) { continue; }
+            push_key(item.key());
+            add_op(string_literal<CharT, 'a', 'd', 'd'>{}, &item.value());
+            path_.resize(path_sz);
+        }
+    }
+};
+
+template<typename CharT, typename Alloc>
+class patch_applier {
+ public:
+    using value_t = basic_value<CharT, Alloc>;
+    using string_view_type = std::basic_string_view<CharT>;
+    using string_type = std::basic_string<CharT>;
+
+    explicit patch_applier(value_t& root) : root_(root) {}
+
+    void apply(const value_t& op) {
+        const string_view_type name = member(op, string_literal<CharT, 'o', 'p'>{}).as_string_view();
+        const string_view_type path = member(op, string_literal<CharT, 'p', 'a', 't', 'h'>{}).as_string_view();
+        if (name == string_view_type(string_literal<CharT, 'a', 'd', 'd'>{})) {
+            add(path, member(op, string_literal<CharT, 'v', 'a', 'l', 'u', 'e'>{}));
+        } else if (name == string_view_type(string_literal<CharT, 'r', 'e', 'm', 'o', 'v', 'e'>{})) {
+            remove(path);
+        } else if (name == string_view_type(string_literal<CharT, 'r', 'e', 'p', 'l', 'a', 'c', 'e'>{})) {
+            locate(path) = member(op, string_literal<CharT, 'v', 'a', 'l', 'u', 'e'>{});
+        } else if (name == string_view_type(string_literal<CharT, 'm', 'o', 'v', 'e'>{})) {
+            const string_view_type from = member(op, string_literal<CharT, 'f', 'r', 'o', 'm'>{}).as_string_view();
+            if (from == path) {
+                locate(path);
+                return;
+            }
+            if (path.size() > from.size() && path.substr(0, from.size()) == from && path[from.size()] == '/') {
+                throw database_error("can't move value into itself");
+            }
+            value_t v = locate(from);
+            remove(from);
+            add(path, std::move(v));
+        } else if (name == string_view_type(string_literal<CharT, 'c', 'o', 'p', 'y'>{})) {
+            const string_view_type from = member(op, string_literal<CharT, 'f', 'r', 'o', 'm'>{}).as_string_view();
+            add(path, value_t(locate(from)));
+        } else if (name == string_view_type(string_literal<CharT, 't', 'e', 's', 't'>{})) {
+            if (locate(path) != member(op, string_literal<CharT, 'v', 'a', 'l', 'u', 'e'>{})) {
+                throw database_error("patch test failed");
+            }
+        } else {
+            throw database_error("invalid patch operation");
+        }
+    }
+
+ private:
+    value_t& root_;
+
+    static const value_t& member(const value_t& op, string_view_type key) {
+        const auto it = op.find(key);
+        if (it == op.end()) { throw database_error("invalid patch operation"); }
+        return it.value();
+    }
+
+    static string_type unescape(string_view_type token) {
+        string_type s;
+        s.reserve(token.size());
+        for (auto p = token.begin(); p != token.end(); ++p) {
+            if (*p != '~') {
+                s += *p;
+            } else if (++p != token.end() && (*p == '0' || *p == '1')) {
+                s += *p == '0' ? '~' : '/';
+            } else {
+                throw database_error("invalid pointer");
+            }
+        }
+        return s;
+    }
+
+    // Parses array index: `size` is allowed only if `allow_end` is `true`, and "-" means it
+    static std::size_t index(string_view_type token, std::size_t size, bool allow_end) {
+        if (allow_end && token.size() == 1 && token[0] == '-') { return size; }
+        if (token.empty() || (token.size() > 1 && token[0] == '0')) { throw database_error("invalid array index"); }
+        std::size_t i = 0;
+        for (const CharT ch : token) {
+            if (ch < '0' || ch > '9' || i > size) { throw database_error("invalid array index"); }
+            i = 10 * i + static_cast<std::size_t>(ch - '0');
+        }
+        if (i > size || (i == size && !allow_end)) { throw database_error("array index is out of range"); }
+        return i;
+    }
+
+    static value_t& child(value_t& v, const string_type& token) {
+        if (v.is_array()) { return v[index(token, v.size(), false)]; }
+        if (v.is_record()) {
+            const auto it = v.find(token);
+            if (it != v.end()) { return it.value(); }
+            throw database_error("pointer refers to nonexistent value");
+        }
+        throw database_error("pointer refers to nonexistent value");
+    }
+
+    // Resolves all tokens of the pointer but the last one, which is returned in `last`
+    value_t& locate_parent(string_view_type path, string_type& last) {
+        if (path.empty() || path[0] != '/') { throw database_error("invalid pointer"); }
+        value_t* v = &root_;
+        std::size_t pos = 1;
+        for (std::size_t next = path.find('/', pos); next != string_view_type::npos; next = path.find('/', pos)) {
+            v = &child(*v, unescape(path.substr(pos, next - pos)));
+            pos = next + 1;
+        }
+        last = unescape(path.substr(pos));
+        return *v;
+    }
+
+    value_t& locate(string_view_type path) {
+        if (path.empty()) { return root_; }
+        string_type last;
+        return child(locate_parent(path, last), last);
+    }
+
+    void add(string_view_type path, value_t v) {
+        if (path.empty()) {
+            root_ = std::move(v);
+            return;
+        }
+        string_type last;
+        value_t& parent = locate_parent(path, last);
+        if (parent.is_array()) {
+            parent.insert(index(last, parent.size(), true), std::move(v));
+        } else if (parent.is_record()) {
+            const auto it = parent.find(last);
+            if (it != parent.end()) {
+                it.value() = std::move(v);
+            } else {
+                parent.emplace(last, std::move(v));
+            }
+        } else {
+            throw database_error("pointer refers to nonexistent value");
+        }
+    }
+
+    void remove(string_view_type path) {
+        string_type last;
+        value_t& parent = locate_parent(path, last);
+        if (parent.is_array()) {
+            parent.erase(index(last, parent.size(), false));
+        } else if (parent.is_record()) {
+            const auto it = parent.find(last);
+            if (it == parent.end()) { throw database_error("pointer refers to nonexistent value"); }
+            parent.erase(it);
+        } else {
+            throw database_error("pointer refers to nonexistent value");
+        }
+    }
+};
+
+}  // namespace detail
+
+template<typename CharT, typename Alloc>
+basic_value<CharT, Alloc> diff(const basic_value<CharT, Alloc>& a, const basic_value<CharT, Alloc>& b) {
+    detail::patch_maker<CharT, Alloc> maker(a.get_allocator());
+    maker.diff(a, b);
+    return std::move(maker.patch());
+}
+
+template<typename CharT, typename Alloc>
+void apply_patch(basic_value<CharT, Alloc>& v, const basic_value<CharT, Alloc>& patch) {
+    if (!patch.is_array()) { throw database_error("invalid patch"); }
+    basic_value<CharT, Alloc> result = v;  // shares storage with `v` until changed
+    detail::patch_applier<CharT, Alloc> applier(result);
+    for (const auto& op : patch.as_array()) { applier.apply(op); }
+    v = std::move(result);
+}
+
+template<typename CharT, typename Alloc>
+bool unordered_equal(const basic_value<CharT, Alloc>& a, const basic_value<CharT, Alloc>& b) {
+    if (a.shares_storage_with(b)) { return true; }
+    if (a.is_array() && b.is_array()) {
+        const auto lhs = a.as_array(), rhs = b.as_array();
+        return lhs.size() == rhs.size() &&
+               std::equal(lhs.begin(), lhs.end(), rhs.begin(), unordered_equal<CharT, Alloc>);
+    }
+    if (!a.is_record() || !b.is_record()) { return a == b; }
+    if (a.size() != b.size()) { return false; }
+    for (const auto& item : a.as_record()) {
+        const auto it = b.find(item.key());
+        if (it == b.end()) { return false; }
+        const std::size_t count = a.count(item.key());
+        if (count == 1) {
+            if (b.count(item.key()) != 1 || !unordered_equal(item.value(), it.value())) { return false; }
+            continue;
+        }
+        // values of duplicate keys are compared in order, once for each key
+        if (&a.find(item.key()).value() != &item.value()) { continue; }
+        if (b.count(item.key()) != count) { return false; }
+        auto rhs_it = b.begin();
+        for (auto lhs_it = a.begin(); lhs_it != a.end(); ++lhs_it) {
+            if (lhs_it.key() != item.key()) { continue; }
+            while (rhs_it.key() != item.key()) { ++rhs_it; }
+            if (!unordered_equal(lhs_it.value(), rhs_it.value())) { return false; }
+            ++rhs_it;
+        }
+    }
+    return true;
+}
+
+}  // namespace json
+}  // namespace db
+}  // namespace uxs
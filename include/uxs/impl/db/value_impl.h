@@ -4,6 +4,8 @@
 #include "uxs/string_cvt.h"
 
 #include <cmath>
+#include <unordered_set>
+#include <vector>
 
 namespace uxs {
 namespace db {
@@ -13,39 +15,59 @@ namespace db {
 template<typename CharT, typename Alloc>
 UXS_EXPORT bool operator==(const basic_value<CharT, Alloc>& lhs, const basic_value<CharT, Alloc>& rhs) noexcept {
     static const auto compare_long_integer = [](std::int64_t lhs, const basic_value<CharT, Alloc>& rhs) {
-        switch (rhs.type_) {
-            case dtype::integer: return lhs == rhs.value_.i;
-            case dtype::unsigned_integer: return lhs == static_cast<std::int64_t>(rhs.value_.u);
-            case dtype::long_integer: return lhs == rhs.value_.i64;
+        switch (rhs.data_.type) {
+            case dtype::integer: return lhs == rhs.data_.value.i;
+            case dtype::unsigned_integer: return lhs == static_cast<std::int64_t>(rhs.data_.value.u);
+            case dtype::long_integer: return lhs == rhs.data_.value.i64;
             case dtype::unsigned_long_integer: {
-                return rhs.value_.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) &&
-                       lhs == static_cast<std::int64_t>(rhs.value_.u64);
+                return rhs.data_.value.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) &&
+                       lhs == static_cast<std::int64_t>(rhs.data_.value.u64);
             } break;
             default: return false;
         }
     };
 
     static const auto compare_unsigned_long_integer = [](std::uint64_t lhs, const basic_value<CharT, Alloc>& rhs) {
-        switch (rhs.type_) {
-            case dtype::integer: return rhs.value_.i >= 0 && lhs == static_cast<std::uint64_t>(rhs.value_.i);
-            case dtype::unsigned_integer: return lhs == rhs.value_.u;
-            case dtype::long_integer: return rhs.value_.i64 >= 0 && lhs == static_cast<std::uint64_t>(rhs.value_.i64);
-            case dtype::unsigned_long_integer: return lhs == rhs.value_.u64;
+        switch (rhs.data_.type) {
+            case dtype::integer: return rhs.data_.value.i >= 0 && lhs == static_cast<std::uint64_t>(rhs.data_.value.i);
+            case dtype::unsigned_integer: return lhs == rhs.data_.value.u;
+            case dtype::long_integer:
+                return rhs.data_.value.i64 >= 0 && lhs == static_cast<std::uint64_t>(rhs.data_.value.i64);
+            case dtype::unsigned_long_integer: return lhs == rhs.data_.value.u64;
             default: return false;
         }
     };
 
-    switch (lhs.type_) {
-        case dtype::null: return rhs.type_ == dtype::null;
-        case dtype::boolean: return rhs.type_ == dtype::boolean && lhs.value_.b == rhs.value_.b;
-        case dtype::integer: return compare_long_integer(lhs.value_.i, rhs);
-        case dtype::unsigned_integer: return compare_unsigned_long_integer(lhs.value_.u, rhs);
-        case dtype::long_integer: return compare_long_integer(lhs.value_.i64, rhs);
-        case dtype::unsigned_long_integer: return compare_unsigned_long_integer(lhs.value_.u64, rhs);
-        case dtype::double_precision: return rhs.type_ == dtype::double_precision && lhs.value_.dbl == rhs.value_.dbl;
-        case dtype::string: return rhs.type_ == dtype::string && lhs.value_.str == rhs.value_.str;
-        case dtype::array: return rhs.type_ == dtype::array && lhs.value_.arr == rhs.value_.arr;
-        case dtype::record: return rhs.type_ == dtype::record && lhs.value_.rec == rhs.value_.rec;
+    switch (lhs.data_.type) {
+        case dtype::null: return rhs.data_.type == dtype::null;
+        case dtype::boolean: return rhs.data_.type == dtype::boolean && lhs.data_.value.b == rhs.data_.value.b;
+        case dtype::integer: return compare_long_integer(lhs.data_.value.i, rhs);
+        case dtype::unsigned_integer: return compare_unsigned_long_integer(lhs.data_.value.u, rhs);
+        case dtype::long_integer: return compare_long_integer(lhs.data_.value.i64, rhs);
+        case dtype::unsigned_long_integer: return compare_unsigned_long_integer(lhs.data_.value.u64, rhs);
+        case dtype::double_precision:
+            return rhs.data_.type == dtype::double_precision && lhs.data_.value.dbl == rhs.data_.value.dbl;
+        case dtype::string: return rhs.data_.type == dtype::string && lhs.str_view() == rhs.str_view();
+        case dtype::array: return rhs.data_.type == dtype::array && lhs.data_.value.arr == rhs.data_.value.arr;
+        case dtype::record: return rhs.data_.type == dtype::record && lhs.data_.value.rec == rhs.data_.value.rec;
+        default: UXS_UNREACHABLE_CODE;
+    }
+}
+
+template<typename CharT, typename Alloc>
+std::size_t basic_value<CharT, Alloc>::hash() const noexcept {
+    switch (data_.type) {
+        case dtype::null: return 0;
+        case dtype::boolean: return detail::hash_mix(data_.value.b ? 2 : 1);
+        case dtype::integer:
+            return detail::hash_mix(static_cast<std::uint64_t>(static_cast<std::int64_t>(data_.value.i)));
+        case dtype::unsigned_integer: return detail::hash_mix(data_.value.u);
+        case dtype::long_integer: return detail::hash_mix(static_cast<std::uint64_t>(data_.value.i64));
+        case dtype::unsigned_long_integer: return detail::hash_mix(data_.value.u64);
+        case dtype::double_precision: return std::hash<double>{}(data_.value.dbl);
+        case dtype::string: return std::hash<std::basic_string_view<char_type>>{}(str_view());
+        case dtype::array:
+        case dtype::record: return detail::container_hash(*this, [](const basic_value& x) { return x.hash(); });
         default: UXS_UNREACHABLE_CODE;
     }
 }
@@ -88,7 +110,7 @@ template<typename Ty, typename Alloc>
 /*static*/ auto flexarray_t<Ty, Alloc>::alloc(alloc_type& al, std::size_t sz, std::size_t cap) -> data_t* {
     const std::size_t alloc_sz = get_alloc_sz(cap);
     data_t* p = alloc_traits::allocate(al, alloc_sz);
-    ::new (&p->ref_count) std::atomic<std::size_t>{1};
+    ::new (&p->ref_count) ref_count_t<Alloc>{1};
     p->size = sz;
     p->capacity = (alloc_sz * sizeof(data_t) - offsetof(data_t, x)) / sizeof(Ty);
     assert(p->capacity >= cap && get_alloc_sz(p->capacity) == alloc_sz);
@@ -163,6 +185,13 @@ template<typename Ty, typename Alloc>
 void flexarray_t<Ty, Alloc>::append(alloc_type& al, const_view_type init) {
     if (!p_) { return create_impl(al, init.size(), init.data()); }
     make_unique(al);
+    if (init.size() + tail_zero > p_->capacity - p_->size && !std::less<const Ty*>{}(init.data(), p_->data()) &&
+        std::less<const Ty*>{}(init.data(), p_->data() + p_->size)) {
+        // `init` refers to items of this array, which are moved to the same places of the new block
+        const std::size_t offset = static_cast<std::size_t>(init.data() - p_->data());
+        grow(al, init.size() + tail_zero);
+        init = const_view_type(p_->data() + offset, init.size());
+    }
     append_impl(al, init.size(), init.data());
 }
 
@@ -237,53 +266,179 @@ template<typename CharT, typename Alloc>
     if (key.size() > max_name_size(al)) { throw std::length_error("too much to reserve"); }
     const std::size_t alloc_sz = get_alloc_sz(key.size());
     record_value* node = alloc_traits::allocate(al, alloc_sz);
-    node->key_sz_ = key.size();
-    std::copy_n(key.data(), key.size(), node->key_chars_);
+    char_type* key_chars = reinterpret_cast<char_type*>(node + 1);
+    std::copy_n(key.data(), key.size(), key_chars);
+    node->key_ = key_chars;
+    node->key_sz_ = static_cast<std::uint32_t>(key.size());
     return node;
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::data_t::init() noexcept {
-    dllist_make_cycle(&head);
-    size = 0;
-    node_traits::set_head(&head, &head);
-    for (auto& item : est::as_span(hashtbl, bucket_count)) { item = nullptr; }
+std::size_t record_shape<CharT, Alloc>::find(key_type key, std::size_t hash_code) const noexcept {
+    using record_t = detail::record_t<CharT, Alloc>;
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = record_t::get_ctrl_size(bucket_count_) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    for (std::size_t g = (hash_code >> 7) & group_mask, n = 0; n <= group_mask; g = (g + 1) & group_mask, ++n) {
+        const record_ctrl_group group(ctrl() + g * width);
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            const std::size_t pos = positions()[g * width + record_ctrl_ctz(mask)];
+            if (keys()[pos] == key) { return pos; }
+        }
+        if (group.match_empty()) { break; }
+    }
+    return size_;
+}
+
+template<typename CharT, typename Alloc>
+/*static*/ auto record_shape<CharT, Alloc>::create(alloc_type& al, node_t* const* nodes, std::size_t count,
+                                                   std::size_t hash_code) -> record_shape* {
+    using record_t = detail::record_t<CharT, Alloc>;
+    const std::size_t bucket_count = record_t::get_bucket_count(count);
+    const std::size_t ctrl_size = record_t::get_ctrl_size(bucket_count);
+    std::size_t key_chars_count = 0;
+    for (const node_t* node : est::as_span(nodes, count)) { key_chars_count += node->key().size(); }
+    const std::size_t alloc_sz = (2 * sizeof(record_shape) + count * sizeof(key_type) +
+                                  bucket_count * sizeof(std::uint32_t) + ctrl_size + key_chars_count * sizeof(CharT) -
+                                  1) /
+                                 sizeof(record_shape);
+    record_shape* shape = alloc_traits::allocate(al, alloc_sz);
+    ::new (&shape->ref_count_) ref_count_t<Alloc>{1};
+    shape->size_ = count;
+    shape->bucket_count_ = bucket_count;
+    shape->hash_code_ = hash_code;
+    shape->alloc_sz_ = alloc_sz;
+    ::new (&shape->al_) alloc_type(al);
+    key_type* keys = shape->key_storage();
+    std::uint32_t* positions = shape->positions();
+    std::int8_t* ctrl = shape->ctrl();
+    std::memset(ctrl, static_cast<std::uint8_t>(record_ctrl_empty), bucket_count);
+    std::memset(ctrl + bucket_count, static_cast<std::uint8_t>(record_ctrl_sentinel), ctrl_size - bucket_count);
+
+    CharT* key_chars = reinterpret_cast<CharT*>(ctrl + ctrl_size);
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = ctrl_size / width - 1;
+    for (std::size_t pos = 0; pos < count; ++pos) {
+        const key_type key = nodes[pos]->key();
+        const std::size_t key_hash_code = typename record_t::hasher_t{}(key);
+        const std::int8_t h2 = static_cast<std::int8_t>(key_hash_code & 0x7f);
+        for (std::size_t g = (key_hash_code >> 7) & group_mask;; g = (g + 1) & group_mask) {
+            const record_ctrl_group group(ctrl + g * width);
+            for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+                if (keys[positions[g * width + record_ctrl_ctz(mask)]] == key) {
+                    alloc_traits::deallocate(al, shape, alloc_sz);
+                    return nullptr;
+                }
+            }
+            if (const std::uint32_t mask = group.match_empty()) {
+                const std::size_t slot = g * width + record_ctrl_ctz(mask);
+                ctrl[slot] = h2;
+                positions[slot] = static_cast<std::uint32_t>(pos);
+                break;
+            }
+        }
+        std::copy_n(key.data(), key.size(), key_chars);
+        keys[pos] = key_type(key_chars, key.size());
+        key_chars += key.size();
+    }
+    return shape;
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::data_t::init_from(data_t* p) noexcept {
-    if (p->size) {
-        head = p->head;
-        head.next->prev = &head;
-        head.prev->next = &head;
-    } else {
-        dllist_make_cycle(&head);
-    }
-    size = p->size;
-    node_traits::set_head(&head, &head);
-    for (auto& item : est::as_span(hashtbl, bucket_count)) { item = nullptr; }
+void record_t<CharT, Alloc>::data_t::reset_index() noexcept {
+    std::memset(ctrl(), static_cast<std::uint8_t>(record_ctrl_empty), bucket_count);
+    std::memset(ctrl() + bucket_count, static_cast<std::uint8_t>(record_ctrl_sentinel),
+                get_ctrl_size(bucket_count) - bucket_count);
+    deleted_count = 0;
+    erased_count = 0;
+    first = 0;
+    put_end_mark();
 }
 
 template<typename CharT, typename Alloc>
 /*static*/ auto record_t<CharT, Alloc>::alloc(alloc_type& al, std::size_t bucket_count) -> data_t* {
-    const std::size_t alloc_sz = get_alloc_sz(bucket_count);
-    data_t* p = alloc_traits::allocate(al, alloc_sz);
-    ::new (&p->ref_count) std::atomic<std::size_t>{1};
-    p->bucket_count = (alloc_sz * sizeof(data_t) - offsetof(data_t, hashtbl)) / sizeof(list_links_t*);
-    assert(p->bucket_count >= bucket_count && get_alloc_sz(p->bucket_count) == alloc_sz);
+    data_t* p = alloc_traits::allocate(al, get_alloc_sz(bucket_count));
+    ::new (&p->ref_count) ref_count_t<Alloc>{1};
+    p->size = 0;
+    p->bucket_count = bucket_count;
+    p->shape = nullptr;
+    p->small = nullptr;
+    p->capacity = 0;
+    p->key_capacity = 0;
+    p->reset_index();
+    return p;
+}
+
+template<typename CharT, typename Alloc>
+/*static*/ auto record_t<CharT, Alloc>::alloc_small(alloc_type& al, std::size_t capacity, std::size_t key_capacity)
+    -> data_t* {
+    data_t* p = alloc_traits::allocate(al, get_small_alloc_sz(capacity, key_capacity));
+    ::new (&p->ref_count) ref_count_t<Alloc>{1};
+    p->size = 0;
+    p->bucket_count = 0;
+    p->shape = nullptr;
+    p->small = nullptr;
+    p->capacity = static_cast<std::uint32_t>(capacity);
+    p->key_capacity = static_cast<std::uint32_t>(key_capacity);
+    p->deleted_count = 0;
+    p->erased_count = 0;
+    p->first = 0;
+    // node pointers are never null, so the one following the last item marks the end, and places are free
+    for (std::size_t pos = 0; pos < capacity; ++pos) {
+        p->nodes()[pos] = p->inline_nodes() + pos;
+        p->inline_nodes()[pos].key_ = nullptr;
+    }
+    p->nodes()[capacity] = p->inline_nodes() + capacity;
+    return p;
+}
+
+template<typename CharT, typename Alloc>
+/*static*/ auto record_t<CharT, Alloc>::alloc_shaped(alloc_type& al, shape_t* shape) -> data_t* {
+    data_t* p = alloc_traits::allocate(al, get_small_alloc_sz(shape->size(), 0));
+    ::new (&p->ref_count) ref_count_t<Alloc>{1};
+    p->size = shape->size();
+    p->bucket_count = 0;
+    p->shape = shape;
+    p->small = nullptr;
+    p->capacity = static_cast<std::uint32_t>(p->size);
+    p->key_capacity = 0;
+    p->deleted_count = 0;
+    p->erased_count = 0;
+    p->first = 0;
+    p->put_end_mark();
+    shape->ref();
+    node_t* node = p->inline_nodes();
+    for (std::size_t pos = 0; pos < p->size; ++pos, ++node) {
+        const key_type key = shape->keys()[pos];
+        node->key_ = key.data();
+        node->key_sz_ = static_cast<std::uint32_t>(key.size());
+        node->index_ = static_cast<std::uint32_t>(pos);
+        p->nodes()[pos] = node;
+    }
     return p;
 }
 
 template<typename CharT, typename Alloc>
 void record_t<CharT, Alloc>::construct(alloc_type& al, record_t rec) {
-    construct(al, rec.size());
+    if (!rec.p_->shape) { return copy_nodes(al, rec); }
+    // values are copied without exceptions
+    p_ = alloc_shaped(al, rec.p_->shape);
+    typename node_t::alloc_type node_al(al);
+    node_t* const* src = rec.cbegin();
+    for (node_t* node : est::as_span(cbegin(), size())) {
+        node_t::alloc_traits::construct(node_al, &node->value(), (*src++)->value());
+    }
+}
+
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::copy_nodes(alloc_type& al, const record_t& rec) {
+    if (rec.size() <= small_max_size) {
+        p_ = alloc_small(al, rec.size(), rec.small_key_count());
+    } else {
+        construct(al, rec.size());
+    }
     try {
-        typename node_t::alloc_type node_al(al);
-        for (list_links_t* item = rec.p_->head.next; item != &rec.p_->head; item = item->next) {
-            const auto& v = *node_t::from_links(item);
-            node_t* node = node_t::create(node_al, v.key(), v.value());
-            insert_node(node, v.hash_code_);
-        }
+        for (const node_t& v : rec.crange()) { emplace_impl(al, v.key(), v.value()); }
     } catch (...) {
         destruct(al);
         throw;
@@ -313,40 +468,80 @@ void record_t<CharT, Alloc>::assign(alloc_type& al, std::initializer_list<mapped
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::destruct_items(alloc_type& al) noexcept {
+void record_t<CharT, Alloc>::destroy_node(alloc_type& al, node_t* node) noexcept {
     typename node_t::alloc_type node_al(al);
-    list_links_t* node = p_->head.next;
-    while (node != &p_->head) {
-        list_links_t* next = node->next;
-        node_t::destroy(node_al, node_t::from_links(node));
-        node = next;
+    if (is_inline_node(node)) {
+        node_t::alloc_traits::destroy(node_al, &node->value());
+    } else {
+        node_t::destroy(node_al, node);
     }
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::add_to_hash(node_t* node) noexcept {
-    node_traits::set_head(&node->links_, &p_->head);
-    list_links_t** p_next_bucket = &p_->hashtbl[node->hash_code_ % p_->bucket_count];
-    node->next_bucket_ = *p_next_bucket;
-    *p_next_bucket = &node->links_;
+void record_t<CharT, Alloc>::destruct_items(alloc_type& al) noexcept {
+    if (!p_->bucket_count) {
+        typename node_t::alloc_type node_al(al);
+        for (node_t* node : est::as_span(p_->nodes(), p_->size)) {
+            node_t::alloc_traits::destroy(node_al, &node->value());
+            node->key_ = nullptr;
+        }
+        return;
+    }
+    for (node_t** pos = cbegin(); pos != cend(); ++pos) {
+        if (*pos) { destroy_node(al, *pos); }
+    }
+    if (p_->small) {
+        dealloc(al, p_->small);
+        p_->small = nullptr;
+    }
+}
+
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::add_to_index(node_t* node, std::size_t hash_code) noexcept {
+    // the latest of equal keys must be met first while probing, so it takes the slot of the first met equal key, and
+    // the displaced node is moved further
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = get_ctrl_size(p_->bucket_count) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    std::int8_t* ctrl = p_->ctrl();
+    node_t** slots = p_->slots();
+    std::size_t target = p_->bucket_count;
+    for (std::size_t g = (hash_code >> 7) & group_mask, n = 0; n <= group_mask; g = (g + 1) & group_mask, ++n) {
+        const record_ctrl_group group(ctrl + g * width);
+        std::uint32_t free_mask = group.match_empty_or_deleted();
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            const std::size_t slot = g * width + record_ctrl_ctz(mask);
+            if (slots[slot]->key() == node->key()) {
+                std::swap(slots[slot], node);
+                target = p_->bucket_count;
+                free_mask &= ~((mask ^ (mask - 1)));  // free slots after the displaced one only
+            }
+        }
+        if (target == p_->bucket_count && free_mask) { target = g * width + record_ctrl_ctz(free_mask); }
+        if (group.match_empty()) { break; }
+    }
+    assert(target < p_->bucket_count);
+    if (ctrl[target] == record_ctrl_deleted) { --p_->deleted_count; }
+    ctrl[target] = h2;
+    slots[target] = node;
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::insert_node(node_t* node, std::size_t hash_code) noexcept {
-    node->hash_code_ = hash_code;
-    add_to_hash(node);
-    dllist_insert_before(&p_->head, &node->links_);
+auto record_t<CharT, Alloc>::insert_node(node_t* node, std::size_t hash_code) noexcept -> node_t** {
+    node_t** pos = p_->nodes_end();
+    node->index_ = static_cast<std::uint32_t>(pos - p_->nodes());
+    *pos = node;
     ++p_->size;
+    p_->put_end_mark();
+    add_to_index(node, hash_code);
+    return pos;
 }
 
 template<typename CharT, typename Alloc>
 void record_t<CharT, Alloc>::insert_impl(alloc_type& al, std::initializer_list<mapped_type> init) {
-    if (p_->bucket_count - p_->size < init.size()) { rehash(al, init.size()); }
-    typename node_t::alloc_type node_al(al);
+    grow(al, init.size(), init.size() * small_key_reserve);
     for (auto first = init.begin(); first != init.end(); ++first) {
-        const auto key = (*first).value_.arr[0].value_.str.cview();
-        node_t* node = node_t::create(node_al, key, (*first).value_.arr[1]);
-        insert_node(node, hasher_t{}(key));
+        emplace_impl(al, (*first).data_.value.arr[0].str_view(), (*first).data_.value.arr[1]);
     }
 }
 
@@ -358,13 +553,27 @@ void record_t<CharT, Alloc>::rehash(alloc_type& al, std::size_t extra) {
         if (extra > max_count - p_->size) { throw std::length_error("too much to reserve"); }
         delta_count = std::max(extra, (max_count - p_->size) >> 1);
     }
-    data_t* p_new = alloc(al, p_->size + delta_count);
-    p_new->init_from(p_);
-    dealloc(al, p_);
-    p_ = p_new;
-    for (list_links_t* node = p_->head.next; node != &p_->head; node = node->next) {
-        add_to_hash(node_t::from_links(node));
+    data_t* p_new = alloc(al, get_bucket_count(p_->size + delta_count));
+    if (p_->bucket_count) {
+        // null places of erased items are dropped
+        for (node_t** pos = cbegin(); pos != cend(); ++pos) {
+            if (!*pos) { continue; }
+            (*pos)->index_ = static_cast<std::uint32_t>(p_new->size);
+            p_new->nodes()[p_new->size++] = *pos;
+        }
+        p_new->small = p_->small;
+        dealloc(al, p_);
+    } else if (p_->size) {
+        // items of small record stay in their places
+        std::copy_n(p_->nodes(), p_->size, p_new->nodes());
+        p_new->size = p_->size;
+        p_new->small = p_;
+    } else {
+        dealloc(al, p_);
     }
+    p_ = p_new;
+    p_->put_end_mark();
+    for (node_t* node : est::as_span(p_->nodes(), p_->size)) { add_to_index(node, hasher_t{}(node->key())); }
 }
 
 template<typename CharT, typename Alloc>
@@ -374,97 +583,251 @@ void record_t<CharT, Alloc>::make_unique_impl(alloc_type& al) {
     reset(al, new_rec.p_);
 }
 
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::unshape(alloc_type& al) {
+    record_t new_rec;
+    new_rec.copy_nodes(al, *this);
+    reset(al, new_rec.p_);
+}
+
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::share_keys(alloc_type& al, basic_shape_table<CharT, Alloc>& shapes) {
+    if (p_->shape || !p_->size) { return; }
+    if (p_->erased_count) {
+        if (p_->ref_count != 1) {
+            make_unique_impl(al);
+        } else {
+            pack_nodes();
+        }
+    }
+    shape_t* shape = shapes.get(p_->nodes(), p_->size);
+    if (!shape) { return; }
+    // values are moved or copied without exceptions
+    data_t* p_new = alloc_shaped(al, shape);
+    typename node_t::alloc_type node_al(al);
+    node_t* const* src = p_->nodes();
+    for (node_t* node : est::as_span(p_new->nodes(), p_new->size)) {
+        if (p_->ref_count == 1) {
+            node_t::alloc_traits::construct(node_al, &node->value(), std::move((*src++)->value()));
+        } else {
+            node_t::alloc_traits::construct(node_al, &node->value(), (*src++)->value());
+        }
+    }
+    reset(al, p_new);
+}
+
 template<typename CharT, typename Alloc>
 void record_t<CharT, Alloc>::clear_impl(alloc_type& al, std::false_type) {
-    if (p_->ref_count != 1) {
-        reset(al, alloc(al, 0));
+    if (p_->ref_count != 1 || p_->shape) {
+        reset(al, alloc_small(al, 0, 0));
     } else {
         destruct_items(al);
+        p_->size = 0;
+        if (p_->bucket_count) { p_->reset_index(); }
     }
-    p_->init();
 }
 
 template<typename CharT, typename Alloc>
-void record_t<CharT, Alloc>::clear_impl(alloc_type& al, std::size_t bucket_count) {
-    if (p_->ref_count != 1) {
-        if (bucket_count > max_size(al)) { throw std::length_error("too much to reserve"); }
-        reset(al, alloc(al, bucket_count));
+void record_t<CharT, Alloc>::clear_impl(alloc_type& al, std::size_t count) {
+    if (p_->ref_count != 1 || p_->shape) {
+        record_t new_rec;
+        new_rec.construct(al, count);
+        reset(al, new_rec.p_);
     } else {
         destruct_items(al);
+        p_->size = 0;
+        if (p_->bucket_count) { p_->reset_index(); }
     }
-    p_->init();
 }
 
 template<typename CharT, typename Alloc>
 void record_t<CharT, Alloc>::destruct(alloc_type& al) noexcept {
     destruct_items(al);
+    if (p_->shape) { p_->shape->unref(); }
     dealloc(al, p_);
 }
 
 template<typename CharT, typename Alloc>
-list_links_t* record_t<CharT, Alloc>::find_impl(key_type key, std::size_t hash_code) const noexcept {
-    list_links_t* next_bucket = p_->hashtbl[hash_code % p_->bucket_count];
-    while (next_bucket) {
-        const auto& v = *node_t::from_links(next_bucket);
-        if (v.hash_code_ == hash_code && v.key() == key) { return next_bucket; }
-        next_bucket = v.next_bucket_;
+void record_t<CharT, Alloc>::count_memory(std::size_t& bytes, std::size_t& slack) const noexcept {
+    if (!p_->bucket_count) {
+        bytes += get_small_alloc_sz(p_->capacity, p_->key_capacity) * sizeof(data_t);
+        if (!p_->shape) {
+            slack += (p_->capacity - p_->size) * (sizeof(node_t*) + sizeof(node_t)) +
+                     (p_->key_capacity - small_key_count()) * sizeof(CharT);
+        }
+        return;
+    }
+    bytes += get_alloc_sz(p_->bucket_count) * sizeof(data_t);
+    slack += (get_capacity(p_->bucket_count) - p_->size) * sizeof(node_t*);
+    if (p_->small) {
+        // the whole block of small record is slack but places of the remaining items
+        const std::size_t small_bytes = get_small_alloc_sz(p_->small->capacity, p_->small->key_capacity) *
+                                        sizeof(data_t);
+        bytes += small_bytes;
+        slack += small_bytes;
+    }
+    for (node_t* const* pos = cbegin(); pos != cend(); ++pos) {
+        if (!*pos) { continue; }
+        if (is_inline_node(*pos)) {
+            slack -= sizeof(node_t) + (*pos)->key_sz_ * sizeof(CharT);
+            continue;
+        }
+        const std::size_t node_bytes = node_t::get_alloc_sz((*pos)->key_sz_) * sizeof(node_t);
+        bytes += node_bytes;
+        slack += node_bytes - sizeof(node_t) - (*pos)->key_sz_ * sizeof(CharT);
     }
-    return &p_->head;
+}
+
+template<typename CharT, typename Alloc>
+auto record_t<CharT, Alloc>::find_impl(key_type key, std::size_t hash_code) const noexcept -> node_t* {
+    if (p_->shape) {
+        const std::size_t pos = p_->shape->find(key, hash_code);
+        return pos != p_->size ? p_->nodes()[pos] : nullptr;
+    }
+    if (!p_->bucket_count) { return find_small(key); }
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = get_ctrl_size(p_->bucket_count) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    const std::int8_t* ctrl = p_->ctrl();
+    node_t* const* slots = p_->slots();
+    for (std::size_t g = (hash_code >> 7) & group_mask, n = 0; n <= group_mask; g = (g + 1) & group_mask, ++n) {
+        const record_ctrl_group group(ctrl + g * width);
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            node_t* node = slots[g * width + record_ctrl_ctz(mask)];
+            if (node->key() == key) { return node; }
+        }
+        if (group.match_empty()) { break; }
+    }
+    return nullptr;
 }
 
 template<typename CharT, typename Alloc>
 std::size_t record_t<CharT, Alloc>::count(key_type key) const noexcept {
+    if (p_->shape) { return find_impl(key, hasher_t{}(key)) ? 1 : 0; }
     std::size_t count = 0;
+    if (!p_->bucket_count) {
+        for (const node_t* node : est::as_span(p_->nodes(), p_->size)) { count += node->key() == key ? 1 : 0; }
+        return count;
+    }
     const std::size_t hash_code = hasher_t{}(key);
-    list_links_t* next_bucket = p_->hashtbl[hash_code % p_->bucket_count];
-    while (next_bucket) {
-        const auto& v = *node_t::from_links(next_bucket);
-        if (v.hash_code_ == hash_code && v.key() == key) { ++count; }
-        next_bucket = v.next_bucket_;
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = get_ctrl_size(p_->bucket_count) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    const std::int8_t* ctrl = p_->ctrl();
+    node_t* const* slots = p_->slots();
+    for (std::size_t g = (hash_code >> 7) & group_mask, n = 0; n <= group_mask; g = (g + 1) & group_mask, ++n) {
+        const record_ctrl_group group(ctrl + g * width);
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            if (slots[g * width + record_ctrl_ctz(mask)]->key() == key) { ++count; }
+        }
+        if (group.match_empty()) { break; }
     }
     return count;
 }
 
 template<typename CharT, typename Alloc>
-list_links_t* record_t<CharT, Alloc>::erase(alloc_type& al, list_links_t* node) {
-    assert(node != &p_->head);
-    if (p_->ref_count != 1) {
-        record_t new_rec;
-        new_rec.construct(al, *this);
-        list_links_t* new_node = new_rec.p_->head.next;
-        for (list_links_t* item = p_->head.next; item != node; item = item->next) { new_node = new_node->next; }
-        node = new_node;
-        reset(al, new_rec.p_);
+void record_t<CharT, Alloc>::remove_node(alloc_type& al, std::size_t slot) noexcept {
+    // the place of the node is left null, so following items are not shifted
+    node_t* node = p_->slots()[slot];
+    p_->ctrl()[slot] = record_ctrl_deleted;
+    ++p_->deleted_count;
+    p_->nodes()[node->index_] = nullptr;
+    --p_->size, ++p_->erased_count;
+    if (node->index_ == p_->first) {
+        while (!p_->nodes()[++p_->first]) {}
+    }
+    destroy_node(al, node);
+}
+
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::pack_nodes() noexcept {
+    node_t** nodes = p_->nodes();
+    std::size_t count = 0;
+    for (node_t** pos = cbegin(); pos != cend(); ++pos) {
+        if (!*pos) { continue; }
+        (*pos)->index_ = static_cast<std::uint32_t>(count);
+        nodes[count++] = *pos;
     }
-    auto& v = *node_t::from_links(node);
-    list_links_t** p_next_bucket = &p_->hashtbl[v.hash_code_ % p_->bucket_count];
-    while (*p_next_bucket != node) { p_next_bucket = &node_t::from_links(*p_next_bucket)->next_bucket_; }
-    *p_next_bucket = v.next_bucket_;
-    list_links_t* next = dllist_remove(node);
+    p_->erased_count = 0;
+    p_->first = 0;
+    p_->put_end_mark();
+}
+
+template<typename CharT, typename Alloc>
+void record_t<CharT, Alloc>::erase_small(alloc_type& al, std::size_t index) noexcept {
+    // values of other items stay in their places, and key characters of the erased item are left unused
     typename node_t::alloc_type node_al(al);
-    node_t::destroy(node_al, &v);
-    --p_->size;
-    return next;
+    node_t** pos = p_->nodes() + index;
+    node_t::alloc_traits::destroy(node_al, &(*pos)->value());
+    (*pos)->key_ = nullptr;
+    node_t** last = p_->nodes() + --p_->size;
+    for (; pos != last; ++pos) {
+        *pos = *(pos + 1);
+        --(*pos)->index_;
+    }
+}
+
+template<typename CharT, typename Alloc>
+auto record_t<CharT, Alloc>::erase(alloc_type& al, node_t** pos) -> node_t** {
+    assert(pos != cend());
+    if (p_->ref_count != 1 || p_->shape) {
+        // the copy has no null places
+        const auto index = std::count_if(cbegin(), pos, [](const node_t* node) { return node != nullptr; });
+        make_unique_unshaped(al);
+        pos = cbegin() + index;
+    }
+    if (is_small()) {
+        // places of small records are few, so node pointers following the erased one are shifted
+        erase_small(al, pos - cbegin());
+        return pos;
+    }
+    node_t** next = pos;
+    while (!*++next) {}
+    node_t* next_node = next != cend() ? *next : nullptr;
+    const std::size_t hash_code = hasher_t{}((*pos)->key());
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = get_ctrl_size(p_->bucket_count) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    for (std::size_t g = (hash_code >> 7) & group_mask;; g = (g + 1) & group_mask) {
+        const record_ctrl_group group(p_->ctrl() + g * width);
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            const std::size_t slot = g * width + record_ctrl_ctz(mask);
+            if (p_->slots()[slot] == *pos) {
+                remove_node(al, slot);
+                if (p_->erased_count > p_->size) { pack_nodes(); }
+                return next_node ? p_->nodes() + next_node->index_ : cend();
+            }
+        }
+    }
 }
 
 template<typename CharT, typename Alloc>
 std::size_t record_t<CharT, Alloc>::erase(alloc_type& al, key_type key) {
+    if (p_->shape) {
+        if (!find_impl(key, hasher_t{}(key))) { return 0; }
+        unshape(al);
+    }
     make_unique(al);
     const std::size_t old_sz = p_->size;
+    if (is_small()) {
+        for (std::size_t index = p_->size; index > 0; --index) {
+            if (p_->nodes()[index - 1]->key() == key) { erase_small(al, index - 1); }
+        }
+        return old_sz - p_->size;
+    }
     const std::size_t hash_code = hasher_t{}(key);
-    typename node_t::alloc_type node_al(al);
-    list_links_t** p_next_bucket = &p_->hashtbl[hash_code % p_->bucket_count];
-    while (*p_next_bucket) {
-        auto& v = *node_t::from_links(*p_next_bucket);
-        if (v.hash_code_ == hash_code && v.key() == key) {
-            *p_next_bucket = v.next_bucket_;
-            dllist_remove(&v.links_);
-            node_t::destroy(node_al, &v);
-            --p_->size;
-        } else {
-            p_next_bucket = &v.next_bucket_;
+    const std::size_t width = record_ctrl_group::width;
+    const std::size_t group_mask = get_ctrl_size(p_->bucket_count) / width - 1;
+    const std::int8_t h2 = static_cast<std::int8_t>(hash_code & 0x7f);
+    for (std::size_t g = (hash_code >> 7) & group_mask, n = 0; n <= group_mask; g = (g + 1) & group_mask, ++n) {
+        const record_ctrl_group group(p_->ctrl() + g * width);
+        for (std::uint32_t mask = group.match(h2); mask; mask &= mask - 1) {
+            const std::size_t slot = g * width + record_ctrl_ctz(mask);
+            if (p_->slots()[slot]->key() == key) { remove_node(al, slot); }
         }
+        if (group.match_empty()) { break; }
     }
+    if (p_->erased_count > p_->size) { pack_nodes(); }
     return old_sz - p_->size;
 }
 
@@ -483,54 +846,108 @@ bool is_record(std::initializer_list<basic_value<CharT, Alloc>> init) noexcept {
 
 template<typename CharT, typename Alloc>
 basic_value<CharT, Alloc>::basic_value(std::initializer_list<basic_value> init, const Alloc& al)
-    : alloc_type(al), type_(detail::is_record(init) ? dtype::record : dtype::array) {
-    if (type_ == dtype::record) {
+    : alloc_type(al), data_(detail::is_record(init) ? dtype::record : dtype::array) {
+    if (data_.type == dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.construct(rec_al, init);
+        data_.value.rec.construct(rec_al, init);
     } else {
         typename value_array_t::alloc_type arr_al(*this);
-        value_.arr.construct(arr_al, init);
+        data_.value.arr.construct(arr_al, init);
     }
 }
 
 template<typename CharT, typename Alloc>
 basic_value<CharT, Alloc>& basic_value<CharT, Alloc>::operator=(std::basic_string_view<char_type> s) {
-    if (type_ != dtype::string) {
-        if (type_ != dtype::null) { destroy(); }
-        value_.str.construct();
-        type_ = dtype::string;
-    }
     typename char_array_t::alloc_type str_al(*this);
-    value_.str.assign(str_al, s);
+    if (data_.type == dtype::string && !is_sso()) {
+        if (s.size() > sso_capacity) {
+            data_.value.str.assign(str_al, s);
+            return *this;
+        }
+        // `s` can refer to characters of this string
+        char_array_t str = data_.value.str;
+        assign_sso(s);
+        str.unref(str_al);
+        return *this;
+    }
+    if (s.size() <= sso_capacity) {
+        if (data_.type != dtype::string) {
+            if (data_.type != dtype::null) { destroy(); }
+            data_.type = dtype::string;
+        }
+        assign_sso(s);
+        return *this;
+    }
+    char_array_t str;
+    str.construct(str_al, s);
+    if (data_.type != dtype::null) { destroy(); }
+    data_.value.str = str, data_.sso_size = sso_heap;
+    data_.type = dtype::string;
     return *this;
 }
 
+template<typename CharT, typename Alloc>
+void basic_value<CharT, Alloc>::spill_string(std::size_t cap, std::basic_string_view<char_type> tail) {
+    // moves inline characters and `tail` to a newly allocated string
+    assert(is_sso());
+    typename char_array_t::alloc_type str_al(*this);
+    char_array_t str;
+    str.construct();
+    str.reserve(str_al, std::max<std::size_t>(cap, sso_.size + tail.size()));
+    str.append(str_al, str_view());
+    str.append(str_al, tail);
+    data_.type = dtype::string, data_.sso_size = sso_heap, data_.value.str = str;
+}
+
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::string_reserve(std::size_t sz) {
-    if (type_ != dtype::string) { init_as_string(); }
+    if (data_.type != dtype::string) { init_as_string(); }
+    if (is_sso()) {
+        if (sz > sso_capacity) { spill_string(sz, {}); }
+        return;
+    }
     typename char_array_t::alloc_type str_al(*this);
-    value_.str.reserve(str_al, sz);
+    data_.value.str.reserve(str_al, sz);
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::string_resize(std::size_t sz) {
-    if (type_ != dtype::string) { init_as_string(); }
-    typename char_array_t::alloc_type str_al(*this);
-    value_.str.resize(str_al, sz, '\0');
+    string_resize(sz, '\0');
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::string_resize(std::size_t sz, char_type ch) {
-    if (type_ != dtype::string) { init_as_string(); }
+    if (data_.type != dtype::string) { init_as_string(); }
+    if (is_sso()) {
+        if (sz <= sso_capacity) {
+            char_type* chars = sso_.chars;
+            if (sz > sso_.size) { std::fill(chars + sso_.size, chars + sz, ch); }
+            chars[sz] = '\0';
+            sso_.size = static_cast<std::uint8_t>(sz);
+            return;
+        }
+        spill_string(sz, {});
+    }
     typename char_array_t::alloc_type str_al(*this);
-    value_.str.resize(str_al, sz, ch);
+    data_.value.str.resize(str_al, sz, ch);
 }
 
 template<typename CharT, typename Alloc>
 basic_value<CharT, Alloc>& basic_value<CharT, Alloc>::string_append(std::basic_string_view<char_type> s) {
-    if (type_ != dtype::string) { init_as_string(); }
+    if (data_.type != dtype::string) { init_as_string(); }
+    if (is_sso()) {
+        if (s.size() > sso_capacity - sso_.size) {
+            spill_string(sso_.size + s.size(), s);
+            return *this;
+        }
+        char_type* chars = sso_.chars;
+        std::char_traits<char_type>::move(chars + sso_.size, s.data(), s.size());
+        sso_.size += static_cast<std::uint8_t>(s.size());
+        chars[sso_.size] = '\0';
+        return *this;
+    }
     typename char_array_t::alloc_type str_al(*this);
-    value_.str.append(str_al, s);
+    data_.value.str.append(str_al, s);
     return *this;
 }
 
@@ -538,12 +955,12 @@ template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::assign(std::initializer_list<basic_value> init) {
     if (!detail::is_record(init)) { return assign(array_variant_t{}, init.begin(), init.end()); }
     typename record_t::alloc_type rec_al(*this);
-    if (type_ != dtype::record) {
-        if (type_ != dtype::null) { destroy(); }
-        value_.rec.construct(rec_al, init.size());
-        type_ = dtype::record;
+    if (data_.type != dtype::record) {
+        if (data_.type != dtype::null) { destroy(); }
+        data_.value.rec.construct(rec_al, init.size());
+        data_.type = dtype::record;
     }
-    value_.rec.assign(rec_al, init);
+    data_.value.rec.assign(rec_al, init);
 }
 
 template<typename CharT, typename Alloc>
@@ -577,17 +994,17 @@ inline bool is_integral(double d) noexcept {
 
 template<typename CharT, typename Alloc>
 est::optional<bool> basic_value<CharT, Alloc>::get_bool() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
-        case dtype::boolean: return value_.b;
-        case dtype::integer: return value_.i != 0;
-        case dtype::unsigned_integer: return value_.u != 0;
-        case dtype::long_integer: return value_.i64 != 0;
-        case dtype::unsigned_long_integer: return value_.u64 != 0;
-        case dtype::double_precision: return value_.dbl != 0;
+        case dtype::boolean: return data_.value.b;
+        case dtype::integer: return data_.value.i != 0;
+        case dtype::unsigned_integer: return data_.value.u != 0;
+        case dtype::long_integer: return data_.value.i64 != 0;
+        case dtype::unsigned_long_integer: return data_.value.u64 != 0;
+        case dtype::double_precision: return data_.value.dbl != 0;
         case dtype::string: {
             est::optional<bool> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -597,31 +1014,31 @@ est::optional<bool> basic_value<CharT, Alloc>::get_bool() const {
 
 template<typename CharT, typename Alloc>
 est::optional<std::int32_t> basic_value<CharT, Alloc>::get_int() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
         case dtype::boolean: return est::nullopt();
-        case dtype::integer: return value_.i;
+        case dtype::integer: return data_.value.i;
         case dtype::unsigned_integer:
-            return value_.u <= static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max()) ?
-                       est::make_optional(static_cast<std::int32_t>(value_.u)) :
+            return data_.value.u <= static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max()) ?
+                       est::make_optional(static_cast<std::int32_t>(data_.value.u)) :
                        est::nullopt();
         case dtype::long_integer:
-            return value_.i64 >= std::numeric_limits<std::int32_t>::min() &&
-                           value_.i64 <= std::numeric_limits<std::int32_t>::max() ?
-                       est::make_optional(static_cast<std::int32_t>(value_.i64)) :
+            return data_.value.i64 >= std::numeric_limits<std::int32_t>::min() &&
+                           data_.value.i64 <= std::numeric_limits<std::int32_t>::max() ?
+                       est::make_optional(static_cast<std::int32_t>(data_.value.i64)) :
                        est::nullopt();
         case dtype::unsigned_long_integer:
-            return value_.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max()) ?
-                       est::make_optional(static_cast<std::int32_t>(value_.u64)) :
+            return data_.value.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max()) ?
+                       est::make_optional(static_cast<std::int32_t>(data_.value.u64)) :
                        est::nullopt();
         case dtype::double_precision:
-            return value_.dbl >= std::numeric_limits<std::int32_t>::min() &&
-                           value_.dbl <= std::numeric_limits<std::int32_t>::max() ?
-                       est::make_optional(static_cast<std::int32_t>(value_.dbl)) :
+            return data_.value.dbl >= std::numeric_limits<std::int32_t>::min() &&
+                           data_.value.dbl <= std::numeric_limits<std::int32_t>::max() ?
+                       est::make_optional(static_cast<std::int32_t>(data_.value.dbl)) :
                        est::nullopt();
         case dtype::string: {
             est::optional<std::int32_t> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -631,28 +1048,28 @@ est::optional<std::int32_t> basic_value<CharT, Alloc>::get_int() const {
 
 template<typename CharT, typename Alloc>
 est::optional<std::uint32_t> basic_value<CharT, Alloc>::get_uint() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
         case dtype::boolean: return est::nullopt();
         case dtype::integer:
-            return value_.i >= 0 ? est::make_optional(static_cast<std::uint32_t>(value_.i)) : est::nullopt();
-        case dtype::unsigned_integer: return value_.u;
+            return data_.value.i >= 0 ? est::make_optional(static_cast<std::uint32_t>(data_.value.i)) : est::nullopt();
+        case dtype::unsigned_integer: return data_.value.u;
         case dtype::long_integer:
-            return value_.i64 >= 0 &&
-                           value_.i64 <= static_cast<std::int64_t>(std::numeric_limits<std::uint32_t>::max()) ?
-                       est::make_optional(static_cast<std::uint32_t>(value_.i64)) :
+            return data_.value.i64 >= 0 &&
+                           data_.value.i64 <= static_cast<std::int64_t>(std::numeric_limits<std::uint32_t>::max()) ?
+                       est::make_optional(static_cast<std::uint32_t>(data_.value.i64)) :
                        est::nullopt();
         case dtype::unsigned_long_integer:
-            return value_.u64 <= std::numeric_limits<std::uint32_t>::max() ?
-                       est::make_optional(static_cast<std::uint32_t>(value_.u64)) :
+            return data_.value.u64 <= std::numeric_limits<std::uint32_t>::max() ?
+                       est::make_optional(static_cast<std::uint32_t>(data_.value.u64)) :
                        est::nullopt();
         case dtype::double_precision:
-            return value_.dbl >= 0 && value_.dbl <= std::numeric_limits<std::uint32_t>::max() ?
-                       est::make_optional(static_cast<std::uint32_t>(value_.dbl)) :
+            return data_.value.dbl >= 0 && data_.value.dbl <= std::numeric_limits<std::uint32_t>::max() ?
+                       est::make_optional(static_cast<std::uint32_t>(data_.value.dbl)) :
                        est::nullopt();
         case dtype::string: {
             est::optional<std::uint32_t> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -662,25 +1079,25 @@ est::optional<std::uint32_t> basic_value<CharT, Alloc>::get_uint() const {
 
 template<typename CharT, typename Alloc>
 est::optional<std::int64_t> basic_value<CharT, Alloc>::get_int64() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
         case dtype::boolean: return est::nullopt();
-        case dtype::integer: return value_.i;
-        case dtype::unsigned_integer: return static_cast<std::int64_t>(value_.u);
-        case dtype::long_integer: return value_.i64;
+        case dtype::integer: return data_.value.i;
+        case dtype::unsigned_integer: return static_cast<std::int64_t>(data_.value.u);
+        case dtype::long_integer: return data_.value.i64;
         case dtype::unsigned_long_integer:
-            return value_.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) ?
-                       est::make_optional(static_cast<std::int64_t>(value_.u64)) :
+            return data_.value.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) ?
+                       est::make_optional(static_cast<std::int64_t>(data_.value.u64)) :
                        est::nullopt();
         case dtype::double_precision:
             // Note that double(2^63 - 1) will be rounded up to 2^63, so maximum is excluded
-            return value_.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
-                           value_.dbl < static_cast<double>(std::numeric_limits<std::int64_t>::max()) ?
-                       est::make_optional(static_cast<std::int64_t>(value_.dbl)) :
+            return data_.value.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
+                           data_.value.dbl < static_cast<double>(std::numeric_limits<std::int64_t>::max()) ?
+                       est::make_optional(static_cast<std::int64_t>(data_.value.dbl)) :
                        est::nullopt();
         case dtype::string: {
             est::optional<std::int64_t> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -690,23 +1107,25 @@ est::optional<std::int64_t> basic_value<CharT, Alloc>::get_int64() const {
 
 template<typename CharT, typename Alloc>
 est::optional<std::uint64_t> basic_value<CharT, Alloc>::get_uint64() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
         case dtype::boolean: return est::nullopt();
         case dtype::integer:
-            return value_.i >= 0 ? est::make_optional(static_cast<std::uint64_t>(value_.i)) : est::nullopt();
-        case dtype::unsigned_integer: return value_.u;
+            return data_.value.i >= 0 ? est::make_optional(static_cast<std::uint64_t>(data_.value.i)) : est::nullopt();
+        case dtype::unsigned_integer: return data_.value.u;
         case dtype::long_integer:
-            return value_.i64 >= 0 ? est::make_optional(static_cast<std::uint64_t>(value_.i64)) : est::nullopt();
-        case dtype::unsigned_long_integer: return value_.u64;
+            return data_.value.i64 >= 0 ? est::make_optional(static_cast<std::uint64_t>(data_.value.i64)) :
+                                          est::nullopt();
+        case dtype::unsigned_long_integer: return data_.value.u64;
         case dtype::double_precision:
             // Note that double(2^64 - 1) will be rounded up to 2^64, so maximum is excluded
-            return value_.dbl >= 0 && value_.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) ?
-                       est::make_optional(static_cast<std::uint64_t>(value_.dbl)) :
+            return data_.value.dbl >= 0 &&
+                           data_.value.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) ?
+                       est::make_optional(static_cast<std::uint64_t>(data_.value.dbl)) :
                        est::nullopt();
         case dtype::string: {
             est::optional<std::uint64_t> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -716,17 +1135,17 @@ est::optional<std::uint64_t> basic_value<CharT, Alloc>::get_uint64() const {
 
 template<typename CharT, typename Alloc>
 est::optional<double> basic_value<CharT, Alloc>::get_double() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return est::nullopt();
         case dtype::boolean: return est::nullopt();
-        case dtype::integer: return value_.i;
-        case dtype::unsigned_integer: return value_.u;
-        case dtype::long_integer: return static_cast<double>(value_.i64);
-        case dtype::unsigned_long_integer: return static_cast<double>(value_.u64);
-        case dtype::double_precision: return value_.dbl;
+        case dtype::integer: return data_.value.i;
+        case dtype::unsigned_integer: return data_.value.u;
+        case dtype::long_integer: return static_cast<double>(data_.value.i64);
+        case dtype::unsigned_long_integer: return static_cast<double>(data_.value.u64);
+        case dtype::double_precision: return data_.value.dbl;
         case dtype::string: {
             est::optional<double> result(est::in_place_t{});
-            return from_basic_string(value_.str.cview(), *result) ? result : est::nullopt();
+            return from_basic_string(str_view(), *result) ? result : est::nullopt();
         } break;
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
@@ -736,41 +1155,41 @@ est::optional<double> basic_value<CharT, Alloc>::get_double() const {
 
 template<typename CharT, typename Alloc>
 est::optional<std::basic_string<CharT>> basic_value<CharT, Alloc>::get_string() const {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: {
             return est::make_optional<std::basic_string<CharT>>(string_literal<CharT, 'n', 'u', 'l', 'l'>{}());
         } break;
         case dtype::boolean: {
-            return est::make_optional<std::basic_string<CharT>>(value_.b ?
+            return est::make_optional<std::basic_string<CharT>>(data_.value.b ?
                                                                     string_literal<CharT, 't', 'r', 'u', 'e'>{}() :
                                                                     string_literal<CharT, 'f', 'a', 'l', 's', 'e'>{}());
         } break;
         case dtype::integer: {
             inline_basic_dynbuffer<CharT> buf;
-            to_basic_string(buf, value_.i);
+            to_basic_string(buf, data_.value.i);
             return est::make_optional<std::basic_string<CharT>>(buf.data(), buf.size());
         } break;
         case dtype::unsigned_integer: {
             inline_basic_dynbuffer<CharT> buf;
-            to_basic_string(buf, value_.u);
+            to_basic_string(buf, data_.value.u);
             return est::make_optional<std::basic_string<CharT>>(buf.data(), buf.size());
         } break;
         case dtype::long_integer: {
             inline_basic_dynbuffer<CharT> buf;
-            to_basic_string(buf, value_.i64);
+            to_basic_string(buf, data_.value.i64);
             return est::make_optional<std::basic_string<CharT>>(buf.data(), buf.size());
         } break;
         case dtype::unsigned_long_integer: {
             inline_basic_dynbuffer<CharT> buf;
-            to_basic_string(buf, value_.u64);
+            to_basic_string(buf, data_.value.u64);
             return est::make_optional<std::basic_string<CharT>>(buf.data(), buf.size());
         } break;
         case dtype::double_precision: {
             inline_basic_dynbuffer<CharT> buf;
-            to_basic_string(buf, value_.dbl, fmt_opts{fmt_flags::json_compat});
+            to_basic_string(buf, data_.value.dbl, fmt_opts{fmt_flags::json_compat});
             return est::make_optional<std::basic_string<CharT>>(buf.data(), buf.size());
         } break;
-        case dtype::string: return est::make_optional<std::basic_string<CharT>>(value_.str.cview());
+        case dtype::string: return est::make_optional<std::basic_string<CharT>>(str_view());
         case dtype::array: return est::nullopt();
         case dtype::record: return est::nullopt();
         default: UXS_UNREACHABLE_CODE;
@@ -781,18 +1200,18 @@ est::optional<std::basic_string<CharT>> basic_value<CharT, Alloc>::get_string()
 
 template<typename CharT, typename Alloc>
 bool basic_value<CharT, Alloc>::is_int() const noexcept {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::integer: return true;
         case dtype::unsigned_integer:
-            return value_.u <= static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max());
+            return data_.value.u <= static_cast<std::uint32_t>(std::numeric_limits<std::int32_t>::max());
         case dtype::long_integer:
-            return value_.i64 >= std::numeric_limits<std::int32_t>::min() &&
-                   value_.i64 <= std::numeric_limits<std::int32_t>::max();
+            return data_.value.i64 >= std::numeric_limits<std::int32_t>::min() &&
+                   data_.value.i64 <= std::numeric_limits<std::int32_t>::max();
         case dtype::unsigned_long_integer:
-            return value_.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max());
+            return data_.value.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max());
         case dtype::double_precision:
-            return value_.dbl >= std::numeric_limits<std::int32_t>::min() &&
-                   value_.dbl <= std::numeric_limits<std::int32_t>::max() && detail::is_integral(value_.dbl);
+            return data_.value.dbl >= std::numeric_limits<std::int32_t>::min() &&
+                   data_.value.dbl <= std::numeric_limits<std::int32_t>::max() && detail::is_integral(data_.value.dbl);
         default: break;
     }
     return false;
@@ -800,16 +1219,16 @@ bool basic_value<CharT, Alloc>::is_int() const noexcept {
 
 template<typename CharT, typename Alloc>
 bool basic_value<CharT, Alloc>::is_uint() const noexcept {
-    switch (type_) {
-        case dtype::integer: return value_.i >= 0;
+    switch (data_.type) {
+        case dtype::integer: return data_.value.i >= 0;
         case dtype::unsigned_integer: return true;
         case dtype::long_integer:
-            return value_.i64 >= 0 &&
-                   value_.i64 <= static_cast<std::int64_t>(std::numeric_limits<std::uint32_t>::max());
-        case dtype::unsigned_long_integer: return value_.u64 <= std::numeric_limits<std::uint32_t>::max();
+            return data_.value.i64 >= 0 &&
+                   data_.value.i64 <= static_cast<std::int64_t>(std::numeric_limits<std::uint32_t>::max());
+        case dtype::unsigned_long_integer: return data_.value.u64 <= std::numeric_limits<std::uint32_t>::max();
         case dtype::double_precision:
-            return value_.dbl >= 0 && value_.dbl <= std::numeric_limits<std::uint32_t>::max() &&
-                   detail::is_integral(value_.dbl);
+            return data_.value.dbl >= 0 && data_.value.dbl <= std::numeric_limits<std::uint32_t>::max() &&
+                   detail::is_integral(data_.value.dbl);
         default: break;
     }
     return false;
@@ -817,17 +1236,17 @@ bool basic_value<CharT, Alloc>::is_uint() const noexcept {
 
 template<typename CharT, typename Alloc>
 bool basic_value<CharT, Alloc>::is_int64() const noexcept {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::integer:
         case dtype::unsigned_integer:
         case dtype::long_integer: return true;
         case dtype::unsigned_long_integer:
-            return value_.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+            return data_.value.u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
         case dtype::double_precision:
             // Note that double(2^63 - 1) will be rounded up to 2^63, so maximum is excluded
-            return value_.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
-                   value_.dbl < static_cast<double>(std::numeric_limits<std::int64_t>::max()) &&
-                   detail::is_integral(value_.dbl);
+            return data_.value.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
+                   data_.value.dbl < static_cast<double>(std::numeric_limits<std::int64_t>::max()) &&
+                   detail::is_integral(data_.value.dbl);
         default: break;
     }
     return false;
@@ -835,15 +1254,16 @@ bool basic_value<CharT, Alloc>::is_int64() const noexcept {
 
 template<typename CharT, typename Alloc>
 bool basic_value<CharT, Alloc>::is_uint64() const noexcept {
-    switch (type_) {
-        case dtype::integer: return value_.i >= 0;
+    switch (data_.type) {
+        case dtype::integer: return data_.value.i >= 0;
         case dtype::unsigned_integer: return true;
-        case dtype::long_integer: return value_.i64 >= 0;
+        case dtype::long_integer: return data_.value.i64 >= 0;
         case dtype::unsigned_long_integer: return true;
         case dtype::double_precision:
             // Note that double(2^64 - 1) will be rounded up to 2^64, so maximum is excluded
-            return value_.dbl >= 0 && value_.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) &&
-                   detail::is_integral(value_.dbl);
+            return data_.value.dbl >= 0 &&
+                   data_.value.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) &&
+                   detail::is_integral(data_.value.dbl);
         default: break;
     }
     return false;
@@ -851,16 +1271,16 @@ bool basic_value<CharT, Alloc>::is_uint64() const noexcept {
 
 template<typename CharT, typename Alloc>
 bool basic_value<CharT, Alloc>::is_integral() const noexcept {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::integer:
         case dtype::unsigned_integer:
         case dtype::long_integer:
         case dtype::unsigned_long_integer: return true;
         case dtype::double_precision:
             // Note that double(2^64 - 1) will be rounded up to 2^64, so maximum is excluded
-            return value_.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
-                   value_.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) &&
-                   detail::is_integral(value_.dbl);
+            return data_.value.dbl >= static_cast<double>(std::numeric_limits<std::int64_t>::min()) &&
+                   data_.value.dbl < static_cast<double>(std::numeric_limits<std::uint64_t>::max()) &&
+                   detail::is_integral(data_.value.dbl);
         default: break;
     }
     return false;
@@ -870,10 +1290,10 @@ bool basic_value<CharT, Alloc>::is_integral() const noexcept {
 
 template<typename CharT, typename Alloc>
 std::size_t basic_value<CharT, Alloc>::size() const noexcept {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::null: return 0;
-        case dtype::array: return value_.arr.size();
-        case dtype::record: return value_.rec.size();
+        case dtype::array: return data_.value.arr.size();
+        case dtype::record: return data_.value.rec.size();
         default: break;
     }
     return 1;
@@ -881,10 +1301,10 @@ std::size_t basic_value<CharT, Alloc>::size() const noexcept {
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::begin() -> iterator {
-    if (type_ == dtype::record) {
+    if (data_.type == dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.make_unique(rec_al);
-        return iterator(value_.rec.cbegin());
+        data_.value.rec.make_unique(rec_al);
+        return iterator(data_.value.rec.cbegin(), data_.value.rec.cbegin(), data_.value.rec.cend());
     }
     const auto range = as_array();
     return iterator(range.data(), range.data(), range.data() + range.size());
@@ -892,17 +1312,19 @@ auto basic_value<CharT, Alloc>::begin() -> iterator {
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::begin() const noexcept -> const_iterator {
-    if (type_ == dtype::record) { return const_iterator(value_.rec.cbegin()); }
+    if (data_.type == dtype::record) {
+        return const_iterator(data_.value.rec.cbegin(), data_.value.rec.cbegin(), data_.value.rec.cend());
+    }
     const auto range = as_array();
     return const_iterator(const_cast<value_type*>(range.data()), range.data(), range.data() + range.size());
 }
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::end() -> iterator {
-    if (type_ == dtype::record) {
+    if (data_.type == dtype::record) {
         typename record_t::alloc_type rec_al(*this);
-        value_.rec.make_unique(rec_al);
-        return iterator(value_.rec.cend());
+        data_.value.rec.make_unique(rec_al);
+        return iterator(data_.value.rec.cend(), data_.value.rec.cbegin(), data_.value.rec.cend());
     }
     const auto range = as_array();
     return iterator(range.data() + range.size(), range.data(), range.data() + range.size());
@@ -910,7 +1332,9 @@ auto basic_value<CharT, Alloc>::end() -> iterator {
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::end() const noexcept -> const_iterator {
-    if (type_ == dtype::record) { return const_iterator(value_.rec.cend()); }
+    if (data_.type == dtype::record) {
+        return const_iterator(data_.value.rec.cend(), data_.value.rec.cbegin(), data_.value.rec.cend());
+    }
     const auto range = as_array();
     return const_iterator(const_cast<value_type*>(range.data()) + range.size(), range.data(),
                           range.data() + range.size());
@@ -918,31 +1342,33 @@ auto basic_value<CharT, Alloc>::end() const noexcept -> const_iterator {
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::find(key_type key) const noexcept -> const_iterator {
-    return type_ == dtype::record ? const_iterator(value_.rec.find(key)) : end();
+    if (data_.type != dtype::record) { return end(); }
+    return const_iterator(data_.value.rec.find(key), data_.value.rec.cbegin(), data_.value.rec.cend());
 }
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::find(key_type key) -> iterator {
-    if (type_ != dtype::record) { return end(); }
+    if (data_.type != dtype::record) { return end(); }
     typename record_t::alloc_type rec_al(*this);
-    value_.rec.make_unique(rec_al);
-    return iterator(value_.rec.find(key));
+    data_.value.rec.make_unique(rec_al);
+    return iterator(data_.value.rec.find(key), data_.value.rec.cbegin(), data_.value.rec.cend());
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::clear() {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::string: {
+            if (is_sso()) { return init_sso(); }
             typename char_array_t::alloc_type str_al(*this);
-            value_.str.clear(str_al);
+            data_.value.str.clear(str_al);
         } break;
         case dtype::array: {
             typename value_array_t::alloc_type arr_al(*this);
-            value_.arr.clear(arr_al);
+            data_.value.arr.clear(arr_al);
         } break;
         case dtype::record: {
             typename record_t::alloc_type rec_al(*this);
-            value_.rec.clear(rec_al);
+            data_.value.rec.clear(rec_al);
         } break;
         default: break;
     }
@@ -950,141 +1376,247 @@ void basic_value<CharT, Alloc>::clear() {
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::make_unique() {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::string: {
+            if (is_sso()) { break; }
             typename char_array_t::alloc_type str_al(*this);
-            value_.str.make_unique(str_al);
+            data_.value.str.make_unique(str_al);
         } break;
         case dtype::array: {
             typename value_array_t::alloc_type arr_al(*this);
-            value_.arr.make_unique(arr_al);
+            data_.value.arr.make_unique(arr_al);
         } break;
         case dtype::record: {
             typename record_t::alloc_type rec_al(*this);
-            value_.rec.make_unique(rec_al);
+            data_.value.rec.make_unique(rec_al);
         } break;
         default: break;
     }
 }
 
+template<typename CharT, typename Alloc>
+bool basic_value<CharT, Alloc>::is_unique() const noexcept {
+    switch (data_.type) {
+        case dtype::string: return is_sso() || data_.value.str.is_unique();
+        case dtype::array: return data_.value.arr.is_unique();
+        case dtype::record: return data_.value.rec.is_unique();
+        default: return true;
+    }
+}
+
+template<typename CharT, typename Alloc>
+value_memory_usage basic_value<CharT, Alloc>::memory_usage() const {
+    value_memory_usage usage;
+    std::unordered_set<const void*> shared_blocks;
+    std::vector<std::pair<const basic_value*, bool>> stack{{this, false}};
+
+    // returns `false` if the block is shared and already counted
+    const auto add_block = [&usage, &shared_blocks](const void* p, bool shared, std::size_t bytes,
+                                                    std::size_t slack) {
+        if (shared && !shared_blocks.insert(p).second) { return false; }
+        (shared ? usage.shared_bytes : usage.exclusive_bytes) += bytes;
+        usage.slack_bytes += slack;
+        return true;
+    };
+
+    while (!stack.empty()) {
+        const basic_value& v = *stack.back().first;
+        bool shared = stack.back().second;
+        stack.pop_back();
+        ++usage.type_counts[static_cast<unsigned>(v.data_.type)];
+        switch (v.data_.type) {
+            case dtype::string: {
+                if (v.is_sso()) { break; }
+                const auto& str = v.data_.value.str;
+                add_block(str.storage(), shared || !str.is_unique(), str.alloc_bytes(),
+                          (str.capacity() - str.size()) * sizeof(char_type));
+            } break;
+            case dtype::array: {
+                const auto& arr = v.data_.value.arr;
+                shared = shared || !arr.is_unique();
+                if (!arr.storage() ||
+                    !add_block(arr.storage(), shared, arr.alloc_bytes(),
+                               (arr.capacity() - arr.size()) * sizeof(basic_value))) {
+                    break;
+                }
+                for (const auto& el : arr.cview()) { stack.emplace_back(&el, shared); }
+            } break;
+            case dtype::record: {
+                const auto& rec = v.data_.value.rec;
+                shared = shared || !rec.is_unique();
+                std::size_t bytes = 0, slack = 0;
+                rec.count_memory(bytes, slack);
+                if (!add_block(rec.storage(), shared, bytes, slack)) { break; }
+                if (const auto* shape = rec.shape()) {
+                    if (add_block(shape, shared || !shape->is_unique(), shape->alloc_bytes(), 0)) {
+                        ++usage.shape_count;
+                    }
+                }
+                for (const auto& item : rec.crange()) { stack.emplace_back(&item.value(), shared); }
+            } break;
+            default: break;
+        }
+    }
+    return usage;
+}
+
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::reserve(std::size_t sz) {
-    if (type_ != dtype::array) { init_as_array(); }
+    if (data_.type == dtype::record) {
+        typename record_t::alloc_type rec_al(*this);
+        return data_.value.rec.reserve(rec_al, sz);
+    }
+    if (data_.type != dtype::array) { init_as_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.reserve(arr_al, sz);
+    data_.value.arr.reserve(arr_al, sz);
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::resize(std::size_t sz) {
-    if (type_ != dtype::array) { init_as_array(); }
+    if (data_.type != dtype::array) { init_as_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.resize(arr_al, sz, basic_value());
+    data_.value.arr.resize(arr_al, sz, basic_value());
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::resize(std::size_t sz, const basic_value& v) {
-    if (type_ != dtype::array) { init_as_array(); }
+    if (data_.type != dtype::array) { init_as_array(); }
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.resize(arr_al, sz, v);
+    data_.value.arr.resize(arr_al, sz, v);
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::erase(std::size_t pos) {
-    if (type_ != dtype::array) { throw database_error("not an array"); }
-    assert(pos < value_.arr.size());
+    if (data_.type != dtype::array) { throw database_error("not an array"); }
+    assert(pos < data_.value.arr.size());
     typename value_array_t::alloc_type arr_al(*this);
-    value_.arr.erase(arr_al, value_.arr.cbegin() + pos);
+    data_.value.arr.erase(arr_al, data_.value.arr.cbegin() + pos);
 }
 
 template<typename CharT, typename Alloc>
 auto basic_value<CharT, Alloc>::erase(const_iterator it) -> iterator {
     if (it.is_record()) {
-        if (type_ != dtype::record) { throw database_error("not a record"); }
-        detail::list_links_t* node = static_cast<detail::list_links_t*>(it.ptr_);
-        uxs_iterator_assert(record_t::node_traits::get_head(node) == value_.rec.cend());
+        if (data_.type != dtype::record) { throw database_error("not a record"); }
+        auto** pos = static_cast<typename record_t::node_t**>(it.ptr_);
+        uxs_iterator_assert(it.begin_ == data_.value.rec.cbegin() && it.end_ == data_.value.rec.cend());
         typename record_t::alloc_type rec_al(*this);
-        return iterator(value_.rec.erase(rec_al, node));
+        pos = data_.value.rec.erase(rec_al, pos);
+        return iterator(pos, data_.value.rec.cbegin(), data_.value.rec.cend());
     }
-    if (type_ != dtype::array) { throw database_error("not an array"); }
+    if (data_.type != dtype::array) { throw database_error("not an array"); }
     basic_value* item = static_cast<basic_value*>(it.ptr_);
-    uxs_iterator_assert(it.begin_ == value_.arr.cbegin() && it.end_ == value_.arr.cend());
+    uxs_iterator_assert(it.begin_ == data_.value.arr.cbegin() && it.end_ == data_.value.arr.cend());
     typename value_array_t::alloc_type arr_al(*this);
-    item = value_.arr.erase(arr_al, item);
-    return iterator(item, value_.arr.cbegin(), value_.arr.cend());
+    item = data_.value.arr.erase(arr_al, item);
+    return iterator(item, data_.value.arr.cbegin(), data_.value.arr.cend());
 }
 
 template<typename CharT, typename Alloc>
 std::size_t basic_value<CharT, Alloc>::erase(key_type key) {
-    if (type_ != dtype::record) { throw database_error("not a record"); }
+    if (data_.type != dtype::record) { throw database_error("not a record"); }
+    typename record_t::alloc_type rec_al(*this);
+    return data_.value.rec.erase(rec_al, key);
+}
+
+template<typename CharT, typename Alloc>
+void basic_value<CharT, Alloc>::share_keys(basic_shape_table<CharT, Alloc>& shapes) {
+    if (data_.type != dtype::record) { throw database_error("not a record"); }
     typename record_t::alloc_type rec_al(*this);
-    return value_.rec.erase(rec_al, key);
+    data_.value.rec.share_keys(rec_al, shapes);
 }
 
 // --------------------------
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::init_from(const basic_value& other) noexcept {
-    value_ = other.value_;
-    switch (other.type_) {
-        case dtype::string: value_.str.ref(); break;
-        case dtype::array: value_.arr.ref(); break;
-        case dtype::record: value_.rec.ref(); break;
+    copy_storage(other);
+    switch (other.data_.type) {
+        case dtype::string: {
+            if (!is_sso()) { data_.value.str.ref(); }
+        } break;
+        case dtype::array: data_.value.arr.ref(); break;
+        case dtype::record: data_.value.rec.ref(); break;
         default: break;
     }
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::destroy() noexcept {
-    switch (type_) {
+    switch (data_.type) {
         case dtype::string: {
+            if (is_sso()) { break; }
             typename char_array_t::alloc_type str_al(*this);
-            value_.str.unref(str_al);
+            data_.value.str.unref(str_al);
         } break;
         case dtype::array: {
             typename value_array_t::alloc_type arr_al(*this);
-            value_.arr.unref(arr_al);
+            data_.value.arr.unref(arr_al);
         } break;
         case dtype::record: {
             typename record_t::alloc_type rec_al(*this);
-            value_.rec.unref(rec_al);
+            data_.value.rec.unref(rec_al);
         } break;
         default: break;
     }
-    type_ = dtype::null;
+    data_.type = dtype::null;
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::init_as_string() {
-    if (type_ != dtype::null) { throw database_error("not a string"); }
-    value_.str.construct();
-    type_ = dtype::string;
+    if (data_.type != dtype::null) { throw database_error("not a string"); }
+    init_sso();
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::init_as_array() {
-    if (type_ != dtype::null) { throw database_error("not an array"); }
-    value_.arr.construct();
-    type_ = dtype::array;
+    if (data_.type != dtype::null) { throw database_error("not an array"); }
+    data_.value.arr.construct();
+    data_.type = dtype::array;
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::init_as_record() {
-    if (type_ != dtype::null) { throw database_error("not a record"); }
+    if (data_.type != dtype::null) { throw database_error("not a record"); }
     typename record_t::alloc_type rec_al(*this);
-    value_.rec.construct(rec_al);
-    type_ = dtype::record;
+    data_.value.rec.construct(rec_al);
+    data_.type = dtype::record;
 }
 
 template<typename CharT, typename Alloc>
 void basic_value<CharT, Alloc>::convert_to_array() {
     value_array_t arr;
     arr.construct();
-    if (type_ != dtype::null) {
+    if (data_.type != dtype::null) {
         typename value_array_t::alloc_type arr_al(*this);
         arr.emplace_back(arr_al, std::move(*this));
     }
-    value_.arr = arr;
-    type_ = dtype::array;
+    data_.value.arr = arr;
+    data_.type = dtype::array;
+}
+
+// --------------------------
+
+template<typename CharT, typename Alloc>
+auto basic_shape_table<CharT, Alloc>::get(typename shape_t::node_t* const* nodes, std::size_t count) -> shape_t* {
+    std::size_t hash_code = 0;
+    for (const auto* node : est::as_span(nodes, count)) {
+        hash_code ^= std::hash<typename shape_t::key_type>{}(node->key()) + 0x9e3779b9 + (hash_code << 6) +
+                     (hash_code >> 2);
+    }
+    const auto range = shapes_.equal_range(hash_code);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->equal_keys(nodes, count)) { return it->second; }
+    }
+    if (shapes_.size() >= max_count_) { return nullptr; }
+    shape_t* shape = shape_t::create(al_, nodes, count, hash_code);
+    if (!shape) { return nullptr; }
+    try {
+        shapes_.emplace(hash_code, shape);
+    } catch (...) {
+        shape->unref();
+        throw;
+    }
+    return shape;
 }
 
 }  // namespace db
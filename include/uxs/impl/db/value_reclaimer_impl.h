@@ -0,0 +1,109 @@
+#pragma once
+
+#include "uxs/db/value_reclaimer.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace uxs {
+namespace db {
+
+namespace detail {
+
+// Takes apart the value on the top of the stack: at most `budget` last elements of an array or items of a record are
+// released, and their nested arrays and records are pushed to the stack; returns the count of released elements
+template<typename CharT, typename Alloc>
+std::size_t reclaim_step(std::vector<basic_value<CharT, Alloc>>& stack, std::size_t budget) {
+    basic_value<CharT, Alloc> v = std::move(stack.back());
+    stack.pop_back();
+    if ((!v.is_array() && !v.is_record()) || !v.is_unique()) { return 1; }
+    const std::size_t count = std::min(std::max<std::size_t>(budget, 1), v.size());
+    const std::size_t pos = stack.size();
+    if (v.is_array()) {
+        const auto range = v.as_array();
+        for (std::size_t i = range.size() - count; i < range.size(); ++i) {
+            if (range[i].is_array() || range[i].is_record()) { stack.push_back(std::move(range[i])); }
+        }
+        v.resize(range.size() - count);
+    } else {
+        // items are erased from the end, so nothing is shifted in the record
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto it = std::prev(v.end());
+            if (it.value().is_array() || it.value().is_record()) { stack.push_back(std::move(it.value())); }
+            v.erase(it);
+        }
+    }
+    if (!v.empty()) {
+        // the rest goes under released nested values, so they are taken apart first and the stack stays short
+        stack.push_back(std::move(v));
+        std::rotate(stack.begin() + pos, stack.end() - 1, stack.end());
+    }
+    return count + 1;
+}
+
+}  // namespace detail
+
+template<typename CharT, typename Alloc>
+basic_value_reclaimer<CharT, Alloc>::basic_value_reclaimer(reclaim_mode mode) {
+    if (mode == reclaim_mode::background) { thread_ = std::thread([this] { run(); }); }
+}
+
+template<typename CharT, typename Alloc>
+basic_value_reclaimer<CharT, Alloc>::~basic_value_reclaimer() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            stop_ = true;
+        }
+        work_cv_.notify_one();
+        thread_.join();
+    }
+}
+
+template<typename CharT, typename Alloc>
+void basic_value_reclaimer<CharT, Alloc>::retire(value_t&& v) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        pending_.push_back(std::move(v));
+    }
+    work_cv_.notify_one();
+}
+
+template<typename CharT, typename Alloc>
+bool basic_value_reclaimer<CharT, Alloc>::collect(std::size_t budget) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (std::size_t count = 0; count < budget && !pending_.empty();) {
+        count += detail::reclaim_step(pending_, budget - count);
+    }
+    return pending_.empty();
+}
+
+template<typename CharT, typename Alloc>
+void basic_value_reclaimer<CharT, Alloc>::flush() {
+    if (!thread_.joinable()) {
+        collect(std::numeric_limits<std::size_t>::max());
+        return;
+    }
+    std::unique_lock<std::mutex> lk(mtx_);
+    idle_cv_.wait(lk, [this] { return pending_.empty() && !busy_; });
+}
+
+template<typename CharT, typename Alloc>
+void basic_value_reclaimer<CharT, Alloc>::run() {
+    std::vector<value_t> stack;
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (true) {
+        work_cv_.wait(lk, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) { return; }  // all retired values are destroyed before stopping
+        stack.swap(pending_);
+        busy_ = true;
+        lk.unlock();
+        while (!stack.empty()) { detail::reclaim_step(stack, std::numeric_limits<std::size_t>::max()); }
+        lk.lock();
+        busy_ = false;
+        idle_cv_.notify_all();
+    }
+}
+
+}  // namespace db
+}  // namespace uxs
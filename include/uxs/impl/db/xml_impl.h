@@ -1,5 +1,6 @@
 #pragma once
 
+#include "uxs/db/char_scan.h"
 #include "uxs/db/value.h"
 #include "uxs/db/xml.h"
 
@@ -13,6 +14,27 @@ namespace xml {
 
 template<typename CharT, typename Alloc>
 basic_value<CharT, Alloc> parser::read(std::string_view root_element, const Alloc& al) {
+    auto tt = token_type();
+    while (!eof() && !(tt == token_t::start_element && name() == root_element)) { tt = next(); }
+    if (eof()) { throw database_error("no such element"); }
+    return read_impl<CharT>(nullptr, al);
+}
+
+template<typename CharT, typename Alloc>
+basic_value<CharT, Alloc> parser::read(const path_filter& filter, const Alloc& al) {
+    detail::path_matcher matcher(filter, names_);
+    auto match = detail::path_match::none;
+    for (auto tt = token_type(); tt != token_t::eof; tt = next()) {
+        if (tt != token_t::start_element) { continue; }
+        if ((match = matcher.enter(name())) != detail::path_match::none) { break; }
+        skip_element();  // paths are absolute, so only root elements are matched against the first step
+    }
+    if (eof()) { throw database_error("no such element"); }
+    return read_impl<CharT>(match == detail::path_match::partial ? &matcher : nullptr, al);
+}
+
+template<typename CharT, typename Alloc>
+basic_value<CharT, Alloc> parser::read_impl(detail::path_matcher* matcher, const Alloc& al) {
     static const auto text_to_value = [](std::string_view sval, const Alloc& al) -> basic_value<CharT, Alloc> {
         switch (classify_value(sval)) {
             case value_class::empty:
@@ -54,18 +76,35 @@ basic_value<CharT, Alloc> parser::read(std::string_view root_element, const Allo
         }
     };
 
-    auto tt = token_type();
-    while (!eof() && !(tt == token_t::start_element && name() == root_element)) { tt = next(); }
-    if (eof()) { throw database_error("no such element"); }
+    // names of levels are kept in `names`; elements on `partial` levels are not selected themselves: they are added
+    // as records when the first selected descendant is met, and their text and attributes are not read
+    struct level_t {
+        basic_value<CharT, Alloc>* v;
+        basic_value<CharT, Alloc>* last_item;  // the record item of the last child element
+        std::string_view last_name;            // the interned name of the last child element
+        bool is_partial;
+    };
 
     inline_dynbuffer txt;
     basic_value<CharT, Alloc> result(al);
-    std::vector<std::pair<basic_value<CharT, Alloc>*, std::string>> stack;
+    std::vector<level_t> stack;
+    detail::name_stack names;
 
     stack.reserve(32);
-    stack.emplace_back(&result, root_element);
+    stack.push_back(level_t{&result, nullptr, {}, matcher != nullptr});
+    names.push_back(name(), is_name_interned());
+
+    const auto add_child = [&al](level_t& parent, std::string_view name, bool is_interned) {
+        // the item stays in place until the next child element with other name is added; names not interned are
+        // looked up in the record
+        if (is_interned && parent.last_name.data() == name.data()) { return &parent.last_item->emplace_back(al); }
+        auto result = parent.v->emplace_unique(utf_string_adapter<CharT>{}(name), al);
+        parent.last_item = &result.first.value();
+        parent.last_name = is_interned ? name : std::string_view();
+        return result.second ? parent.last_item : &parent.last_item->emplace_back(al);
+    };
 
-    tt = next();
+    auto tt = next();
 
     while (true) {
         auto& top = stack.back();
@@ -74,26 +113,43 @@ basic_value<CharT, Alloc> parser::read(std::string_view root_element, const Allo
             case token_t::preamble: throw database_error(to_string(lexer_.ln) + ": unexpected document preamble");
             case token_t::entity: throw database_error(to_string(lexer_.ln) + ": unknown entity name");
             case token_t::plain_text: {
-                if (!top.first->is_record()) { txt += text(); }
+                if (!top.is_partial && !top.v->is_record()) { txt += text(); }
             } break;
             case token_t::start_element: {
                 txt.clear();
-                auto result = top.first->emplace_unique(utf_string_adapter<CharT>{}(name()), al);
-                stack.emplace_back(&result.first.value(), name());
-                if (!result.second) { stack.back().first = &result.first.value().emplace_back(al); }
+                if (top.is_partial) {
+                    const auto match = matcher->enter(name());
+                    if (match == detail::path_match::none) {
+                        skip_element();
+                        break;
+                    }
+                    if (match == detail::path_match::partial) {
+                        stack.push_back(level_t{nullptr, nullptr, {}, true});
+                        names.push_back(name(), is_name_interned());
+                        break;
+                    }
+                    for (std::size_t n = 1; n < stack.size(); ++n) {
+                        if (!stack[n].v) { stack[n].v = add_child(stack[n - 1], names[n], names.is_interned(n)); }
+                    }
+                }
+                basic_value<CharT, Alloc>* v = add_child(stack.back(), name(), is_name_interned());
+                stack.push_back(level_t{v, nullptr, {}, false});
+                names.push_back(name(), is_name_interned());
                 for (const auto& attr : attributes()) {
-                    stack.back().first->emplace_unique(utf_string_adapter<CharT>{}(attr.first),
-                                                       text_to_value(attr.second, al));
+                    v->emplace_unique(utf_string_adapter<CharT>{}(attr.first), text_to_value(attr.second, al));
                 }
             } break;
             case token_t::end_element: {
-                if (top.second != name()) {
-                    throw database_error(to_string(lexer_.ln) + ": unterminated element " + top.second);
+                if (!names.is_back(name())) {
+                    throw database_error(to_string(lexer_.ln) + ": unterminated element " + std::string(names.back()));
                 }
-                if (!top.first->is_record() && !txt.empty()) {
-                    *(top.first) = text_to_value(std::string_view(txt.data(), txt.size()), al);
+                if (top.is_partial) {
+                    matcher->leave();
+                } else if (!top.v->is_record() && !txt.empty()) {
+                    *top.v = text_to_value(std::string_view(txt.data(), txt.size()), al);
                 }
                 stack.pop_back();
+                names.pop_back();
                 if (stack.empty()) { return result; }
             } break;
             default: break;
@@ -138,24 +194,34 @@ struct writer_stack_item_t {
     std::basic_string_view<ValueCharT> element_;
 };
 
+template<typename CharT>
+const CharT* find_escaped_char(const CharT* first, const CharT* last) {
+    return std::find_if(first, last, [](CharT ch) {
+        return ch == '&' || ch == '<' || ch == '>' || ch == '\'' || ch == '\"';
+    });
+}
+
+inline const char* find_escaped_char(const char* first, const char* last) {
+    return db::detail::find_xml_escape(first, last);
+}
+
 template<typename CharT>
 basic_membuffer<CharT>& write_text(basic_membuffer<CharT>& out, std::basic_string_view<CharT> text) {
-    auto it0 = text.begin();
-    for (auto it = it0; it != text.end(); ++it) {
-        std::basic_string_view<CharT> esc;
+    const CharT* it0 = text.data();
+    const CharT* last = it0 + text.size();
+    for (const CharT* it = find_escaped_char(it0, last); it != last; it = find_escaped_char(it0, last)) {
+        out += to_string_view(it0, it);
         switch (*it) {
-            case '&': esc = string_literal<CharT, '&', 'a', 'm', 'p', ';'>{}(); break;
-            case '<': esc = string_literal<CharT, '&', 'l', 't', ';'>{}(); break;
-            case '>': esc = string_literal<CharT, '&', 'g', 't', ';'>{}(); break;
-            case '\'': esc = string_literal<CharT, '&', 'a', 'p', 'o', 's', ';'>{}(); break;
-            case '\"': esc = string_literal<CharT, '&', 'q', 'u', 'o', 't', ';'>{}(); break;
-            default: continue;
+            case '&': out += string_literal<CharT, '&', 'a', 'm', 'p', ';'>{}(); break;
+            case '<': out += string_literal<CharT, '&', 'l', 't', ';'>{}(); break;
+            case '>': out += string_literal<CharT, '&', 'g', 't', ';'>{}(); break;
+            case '\'': out += string_literal<CharT, '&', 'a', 'p', 'o', 's', ';'>{}(); break;
+            case '\"': out += string_literal<CharT, '&', 'q', 'u', 'o', 't', ';'>{}(); break;
+            default: UXS_UNREACHABLE_CODE;
         }
-        out += to_string_view(it0, it);
-        out += esc;
         it0 = it + 1;
     }
-    out += to_string_view(it0, text.end());
+    out += to_string_view(it0, last);
     return out;
 }
 
@@ -282,6 +348,80 @@ loop:
     out += '>';
 }
 
+// --------------------------
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::start_element(std::basic_string_view<CharT> name) {
+    begin_child();
+    out_ += '<';
+    out_ += name;
+    stack_.push_back(element_t{names_.size(), false});
+    names_ += name;
+    is_tag_open_ = true;
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::attribute(std::basic_string_view<CharT> name,
+                                                    std::basic_string_view<CharT> value) {
+    if (!is_tag_open_) { throw database_error("unexpected XML attribute"); }
+    out_ += ' ';
+    out_ += name;
+    out_ += string_literal<CharT, '=', '\"'>{}();
+    detail::write_text<CharT>(out_, value);
+    out_ += '\"';
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::text(std::basic_string_view<CharT> text) {
+    if (stack_.empty()) { throw database_error("unexpected XML text outside of element"); }
+    close_tag();
+    detail::write_text<CharT>(out_, text);
+    return *this;
+}
+
+template<typename CharT>
+basic_writer<CharT>& basic_writer<CharT>::end_element() {
+    if (stack_.empty()) { throw database_error("unexpected XML element end"); }
+    const auto& top = stack_.back();
+    if (is_tag_open_) {
+        out_ += string_literal<CharT, '/', '>'>{}();
+        is_tag_open_ = false;
+    } else {
+        if (top.has_children) {
+            out_ += '\n';
+            out_.append(indent_ + static_cast<unsigned>(stack_.size() - 1) * opts_.indent_size, opts_.indent_char);
+        }
+        out_ += string_literal<CharT, '<', '/'>{}();
+        out_ += to_string_view(names_.data() + top.name_offset, names_.data() + names_.size());
+        out_ += '>';
+    }
+    names_.setsize(top.name_offset);
+    stack_.pop_back();
+    end_child();
+    return *this;
+}
+
+template<typename CharT>
+void basic_writer<CharT>::begin_child() {
+    if (stack_.empty()) {
+        if (is_complete_) { throw database_error("XML root element is already complete"); }
+        return;
+    }
+    close_tag();
+    stack_.back().has_children = true;
+    out_ += '\n';
+    out_.append(indent_ + static_cast<unsigned>(stack_.size()) * opts_.indent_size, opts_.indent_char);
+}
+
+template<typename CharT>
+void basic_writer<CharT>::close_tag() {
+    if (!is_tag_open_) { return; }
+    out_ += '>';
+    is_tag_open_ = false;
+}
+
 }  // namespace xml
 }  // namespace db
 }  // namespace uxs
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "sysfile.h"
+
+namespace uxs {
+
+// Read-only file device exposing file contents through a sliding mapped window: `basic_devbuf` reads such a
+// device with no intermediate buffer. If the window is not less than the file size, the file is mapped entirely.
+class UXS_EXPORT_ALL_STUFF_FOR_GNUC mappedfile : public iodevice {
+ public:
+    enum : std::size_t { default_window_size = sizeof(void*) > 4 ? std::size_t(1) << 30 : std::size_t(1) << 24 };
+
+    UXS_EXPORT mappedfile() noexcept;
+    explicit mappedfile(const char* fname, std::size_t window_sz = default_window_size) : mappedfile() {
+        open(fname, window_sz);
+    }
+    explicit mappedfile(const wchar_t* fname, std::size_t window_sz = default_window_size) : mappedfile() {
+        open(fname, window_sz);
+    }
+    ~mappedfile() override { close(); }
+    UXS_EXPORT mappedfile(mappedfile&& other) noexcept;
+    UXS_EXPORT mappedfile& operator=(mappedfile&& other) noexcept;
+
+    UXS_EXPORT bool valid() const noexcept;
+    explicit operator bool() const noexcept { return valid(); }
+    std::uint64_t size() const noexcept { return size_; }
+
+    UXS_EXPORT bool open(const char* fname, std::size_t window_sz = default_window_size);
+    UXS_EXPORT bool open(const wchar_t* fname, std::size_t window_sz = default_window_size);
+    UXS_EXPORT void close() noexcept;
+
+    UXS_EXPORT int read(void* data, std::size_t sz, std::size_t& n_read) override;
+    int write(const void* /*data*/, std::size_t /*sz*/, std::size_t& /*n_written*/) override { return -1; }
+    UXS_EXPORT void* map(std::size_t& sz, bool wr) override;
+    void advance(std::size_t n) override { pos_ += n; }
+    UXS_EXPORT std::int64_t seek(std::int64_t off, seekdir dir) override;
+    int flush() override { return 0; }
+
+ private:
+    file_desc_t fd_;
+#if defined(WIN32)
+    void* mapping_ = nullptr;
+#endif  // defined(WIN32)
+    std::uint64_t size_ = 0;
+    std::uint64_t pos_ = 0;
+    std::uint64_t window_pos_ = 0;
+    std::size_t window_sz_ = 0;
+    std::size_t window_limit_ = default_window_size;
+    void* window_ = nullptr;
+
+    void unmap_window() noexcept;
+};
+
+}  // namespace uxs
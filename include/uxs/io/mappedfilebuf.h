@@ -0,0 +1,90 @@
+#pragma once
+
+#include "devbuf.h"
+#include "mappedfile.h"
+
+namespace uxs {
+
+template<typename CharT>
+class basic_mappedfilebuf : public basic_devbuf<CharT> {
+ public:
+    basic_mappedfilebuf() : basic_devbuf<CharT>(file_) {}
+    explicit basic_mappedfilebuf(const char* fname, iomode mode = default_mode(),
+                                 std::size_t window_sz = mappedfile::default_window_size)
+        : basic_devbuf<CharT>(file_), file_(fname, window_sz) {
+        if (file_.valid()) { this->initbuf(mode); }
+    }
+    explicit basic_mappedfilebuf(const wchar_t* fname, iomode mode = default_mode(),
+                                 std::size_t window_sz = mappedfile::default_window_size)
+        : basic_devbuf<CharT>(file_), file_(fname, window_sz) {
+        if (file_.valid()) { this->initbuf(mode); }
+    }
+    basic_mappedfilebuf(const char* fname, const char* mode)
+        : basic_mappedfilebuf(fname,
+                              detail::iomode_from_str(mode, is_character<CharT>::value ? iomode::text : iomode::none)) {}
+    basic_mappedfilebuf(const wchar_t* fname, const char* mode)
+        : basic_mappedfilebuf(fname,
+                              detail::iomode_from_str(mode, is_character<CharT>::value ? iomode::text : iomode::none)) {}
+
+    ~basic_mappedfilebuf() override { this->freebuf(); }
+
+    basic_mappedfilebuf(basic_mappedfilebuf&& other) noexcept
+        : basic_devbuf<CharT>(std::move(other)), file_(std::move(other.file_)) {
+        this->setdev(&file_);
+    }
+    basic_mappedfilebuf& operator=(basic_mappedfilebuf&& other) noexcept {
+        if (&other == this) { return *this; }
+        basic_devbuf<CharT>::operator=(std::move(other));
+        file_ = std::move(other.file_);
+        this->setdev(&file_);
+        return *this;
+    }
+
+    bool open(const char* fname, iomode mode = default_mode(),
+              std::size_t window_sz = mappedfile::default_window_size) {
+        this->freebuf();
+        const bool res = file_.open(fname, window_sz);
+        if (res) { this->initbuf(mode); }
+        return res;
+    }
+    bool open(const wchar_t* fname, iomode mode = default_mode(),
+              std::size_t window_sz = mappedfile::default_window_size) {
+        this->freebuf();
+        const bool res = file_.open(fname, window_sz);
+        if (res) { this->initbuf(mode); }
+        return res;
+    }
+    bool open(const char* fname, const char* mode) {
+        return open(fname, detail::iomode_from_str(mode, is_character<CharT>::value ? iomode::text : iomode::none));
+    }
+    bool open(const wchar_t* fname, const char* mode) {
+        return open(fname, detail::iomode_from_str(mode, is_character<CharT>::value ? iomode::text : iomode::none));
+    }
+    void close() noexcept {
+        this->freebuf();
+        file_.close();
+    }
+
+ protected:
+    int underflow() override {
+        const int ret = basic_devbuf<CharT>::underflow();
+        // nothing is read before the end of file if the file can't be mapped, and it is reported by exception, so
+        // readers don't take the rest of the file for the end of it
+        if (ret < 0 && file_.valid() && static_cast<std::uint64_t>(file_.seek(0, seekdir::curr)) < file_.size()) {
+            this->setstate(iostate_bits::bad);
+            throw iobuf_error("file mapping error");
+        }
+        return ret;
+    }
+
+ private:
+    mappedfile file_;
+
+    static iomode default_mode() noexcept { return is_character<CharT>::value ? iomode::in | iomode::text : iomode::in; }
+};
+
+using mappedfilebuf = basic_mappedfilebuf<char>;
+using wmappedfilebuf = basic_mappedfilebuf<wchar_t>;
+using bmappedfilebuf = basic_mappedfilebuf<std::uint8_t>;
+
+}  // namespace uxs
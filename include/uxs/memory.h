@@ -2,7 +2,10 @@
 
 #include "utility.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <new>
 
 namespace uxs {
 
@@ -21,6 +24,225 @@ struct is_allocator<Alloc, std::void_t<typename Alloc::value_type, decltype(std:
     : std::true_type {};
 #endif  // __cplusplus < 201703L
 
+template<typename Alloc, typename = void>
+struct is_alloc_monotonic : std::false_type {};
+template<typename Alloc>
+struct is_alloc_monotonic<Alloc, std::void_t<typename Alloc::is_monotonic>> : Alloc::is_monotonic {};
+
+// Containers with single-threaded allocators are never shared between threads, so they can keep reference counters
+// without atomic operations
+template<typename Alloc, typename = void>
+struct is_alloc_single_threaded : std::false_type {};
+template<typename Alloc>
+struct is_alloc_single_threaded<Alloc, std::void_t<typename Alloc::is_single_threaded>> : Alloc::is_single_threaded {};
+
+// --------------------------
+
+// Allocates memory from large blocks and releases all the blocks at once: individual deallocations are no-ops.
+// Not thread-safe.
+class monotonic_arena {
+ public:
+    enum : std::size_t { default_block_size = 0x10000, max_block_size = 0x1000000 };
+
+    explicit monotonic_arena(std::size_t block_sz = default_block_size) noexcept
+        : next_block_sz_(std::max<std::size_t>(block_sz, sizeof(block_t))) {}
+    ~monotonic_arena() { release(); }
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    std::size_t allocated_size() const noexcept { return allocated_sz_; }
+
+    void* allocate(std::size_t sz, std::size_t alignment) {
+        const std::size_t pad = get_pad(curr_, alignment);
+        if (sz + pad <= static_cast<std::size_t>(end_ - curr_) && curr_) {
+            void* p = curr_ + pad;
+            curr_ += pad + sz;
+            return p;
+        }
+        return allocate_from_new_block(sz, alignment);
+    }
+
+    void release() noexcept {
+        while (head_) {
+            block_t* next = head_->next;
+            ::operator delete(head_);
+            head_ = next;
+        }
+        curr_ = end_ = nullptr;
+        allocated_sz_ = 0;
+    }
+
+ private:
+    struct block_t {
+        block_t* next;
+        std::size_t size;
+    };
+
+    block_t* head_ = nullptr;
+    std::uint8_t* curr_ = nullptr;
+    std::uint8_t* end_ = nullptr;
+    std::size_t next_block_sz_;
+    std::size_t allocated_sz_ = 0;
+
+    static std::size_t get_pad(const void* p, std::size_t alignment) noexcept {
+        return static_cast<std::size_t>(0 - reinterpret_cast<std::uintptr_t>(p)) & (alignment - 1);
+    }
+
+    void* allocate_from_new_block(std::size_t sz, std::size_t alignment) {
+        // blocks are aligned for fundamental types only, so the header is followed by room for the worst padding
+        const std::size_t hdr_sz = sizeof(block_t) + alignment - 1;
+        if (sz > std::size_t(-1) - 2 * hdr_sz) { throw std::bad_alloc(); }
+        if (hdr_sz + sz > next_block_sz_ / 2) {  // too big: allocate dedicated block and keep current one
+            std::uint8_t* p = reinterpret_cast<std::uint8_t*>(new_block(hdr_sz + sz) + 1);
+            return p + get_pad(p, alignment);
+        }
+        block_t* block = new_block(next_block_sz_);
+        next_block_sz_ = std::min<std::size_t>(2 * next_block_sz_, max_block_size);
+        std::uint8_t* p = reinterpret_cast<std::uint8_t*>(block + 1);
+        p += get_pad(p, alignment);
+        curr_ = p + sz;
+        end_ = reinterpret_cast<std::uint8_t*>(block) + block->size;
+        return p;
+    }
+
+    block_t* new_block(std::size_t sz) {
+        block_t* block = static_cast<block_t*>(::operator new(sz));
+        block->next = head_, block->size = sz;
+        head_ = block;
+        allocated_sz_ += sz;
+        return block;
+    }
+};
+
+// Allocator for `monotonic_arena`. It satisfies `Alloc` requirements of containers, and memory of monotonic
+// allocators is released with the arena, so containers are allowed not to destroy their contents one by one.
+template<typename Ty>
+class arena_allocator {
+ public:
+    using value_type = Ty;
+    using is_always_equal = std::false_type;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_monotonic = std::true_type;
+
+    template<typename Ty2>
+    struct rebind {
+        using other = arena_allocator<Ty2>;
+    };
+
+    arena_allocator(monotonic_arena& arena) noexcept : arena_(&arena) {}  // NOLINT
+    template<typename Ty2>
+    arena_allocator(const arena_allocator<Ty2>& other) noexcept : arena_(other.arena()) {}  // NOLINT
+
+    monotonic_arena* arena() const noexcept { return arena_; }
+
+    UXS_NODISCARD Ty* allocate(std::size_t n) {
+        if (n > std::size_t(-1) / sizeof(Ty)) { throw std::bad_alloc(); }
+        return static_cast<Ty*>(arena_->allocate(n * sizeof(Ty), alignof(Ty)));
+    }
+    void deallocate(Ty* /*p*/, std::size_t /*n*/) noexcept {}
+
+    template<typename Ty2>
+    friend bool operator==(const arena_allocator& lhs, const arena_allocator<Ty2>& rhs) noexcept {
+        return lhs.arena_ == rhs.arena();
+    }
+    template<typename Ty2>
+    friend bool operator!=(const arena_allocator& lhs, const arena_allocator<Ty2>& rhs) noexcept {
+        return lhs.arena_ != rhs.arena();
+    }
+
+ private:
+    monotonic_arena* arena_;
+};
+
+// Standard allocator marked as single-threaded
+template<typename Ty>
+class single_thread_allocator : public std::allocator<Ty> {
+ public:
+    using is_single_threaded = std::true_type;
+
+    template<typename Ty2>
+    struct rebind {
+        using other = single_thread_allocator<Ty2>;
+    };
+
+    single_thread_allocator() noexcept = default;
+    template<typename Ty2>
+    single_thread_allocator(const single_thread_allocator<Ty2>& /*other*/) noexcept {}  // NOLINT
+};
+
+// Counters of `counting_allocator`: `bytes` are allocated at the moment, `peak_bytes` is their maximum, and
+// `total_bytes` are allocated ever
+struct allocation_stats {
+    std::atomic<std::size_t> allocation_count{0};
+    std::atomic<std::size_t> deallocation_count{0};
+    std::atomic<std::size_t> bytes{0};
+    std::atomic<std::size_t> peak_bytes{0};
+    std::atomic<std::size_t> total_bytes{0};
+};
+
+// Allocator adaptor, which counts allocations of `Alloc` in `allocation_stats` shared by its copies and rebound
+// copies; monotonic and single-threaded properties of `Alloc` are kept
+template<typename Ty, typename Alloc = std::allocator<Ty>>
+class counting_allocator {
+ public:
+    using value_type = Ty;
+    using base_allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Ty>;
+    using is_always_equal = std::false_type;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_monotonic = std::integral_constant<bool, is_alloc_monotonic<Alloc>::value>;
+    using is_single_threaded = std::integral_constant<bool, is_alloc_single_threaded<Alloc>::value>;
+
+    template<typename Ty2>
+    struct rebind {
+        using other = counting_allocator<Ty2, typename std::allocator_traits<Alloc>::template rebind_alloc<Ty2>>;
+    };
+
+    explicit counting_allocator(allocation_stats& stats, const base_allocator_type& al = base_allocator_type())
+        : al_(al), stats_(&stats) {}
+    template<typename Ty2, typename Alloc2>
+    counting_allocator(const counting_allocator<Ty2, Alloc2>& other) noexcept  // NOLINT
+        : al_(other.base()), stats_(other.stats()) {}
+
+    const base_allocator_type& base() const noexcept { return al_; }
+    allocation_stats* stats() const noexcept { return stats_; }
+
+    UXS_NODISCARD Ty* allocate(std::size_t n) {
+        Ty* p = std::allocator_traits<base_allocator_type>::allocate(al_, n);
+        const std::size_t sz = n * sizeof(Ty);
+        const std::size_t bytes = stats_->bytes.fetch_add(sz, std::memory_order_relaxed) + sz;
+        std::size_t peak = stats_->peak_bytes.load(std::memory_order_relaxed);
+        while (bytes > peak && !stats_->peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+        stats_->total_bytes.fetch_add(sz, std::memory_order_relaxed);
+        stats_->allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return p;
+    }
+
+    void deallocate(Ty* p, std::size_t n) noexcept {
+        std::allocator_traits<base_allocator_type>::deallocate(al_, p, n);
+        stats_->bytes.fetch_sub(n * sizeof(Ty), std::memory_order_relaxed);
+        stats_->deallocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template<typename Ty2, typename Alloc2>
+    friend bool operator==(const counting_allocator& lhs, const counting_allocator<Ty2, Alloc2>& rhs) noexcept {
+        return lhs.stats_ == rhs.stats() && lhs.al_ == rhs.base();
+    }
+    template<typename Ty2, typename Alloc2>
+    friend bool operator!=(const counting_allocator& lhs, const counting_allocator<Ty2, Alloc2>& rhs) noexcept {
+        return !(lhs == rhs);
+    }
+
+ private:
+    base_allocator_type al_;
+    allocation_stats* stats_;
+};
+
+// --------------------------
+
 template<typename ToTy, typename FromTy>
 std::unique_ptr<ToTy> static_pointer_cast(std::unique_ptr<FromTy> p) {
     return std::unique_ptr<ToTy>(static_cast<ToTy*>(p.release()));
@@ -0,0 +1,84 @@
+#include "uxs/io/mappedfile.h"
+
+#include "uxs/string_util.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace uxs;
+
+mappedfile::mappedfile() noexcept : iodevice(iodevcaps::rdonly | iodevcaps::mappable), fd_(-1) {}
+
+mappedfile::mappedfile(mappedfile&& other) noexcept
+    : iodevice(iodevcaps::rdonly | iodevcaps::mappable), fd_(other.fd_), size_(other.size_), pos_(other.pos_),
+      window_pos_(other.window_pos_), window_sz_(other.window_sz_), window_limit_(other.window_limit_),
+      window_(other.window_) {
+    other.fd_ = -1, other.size_ = other.pos_ = 0, other.window_ = nullptr;
+}
+
+mappedfile& mappedfile::operator=(mappedfile&& other) noexcept {
+    if (&other == this) { return *this; }
+    close();
+    fd_ = other.fd_, size_ = other.size_, pos_ = other.pos_;
+    window_pos_ = other.window_pos_, window_sz_ = other.window_sz_, window_limit_ = other.window_limit_;
+    window_ = other.window_;
+    other.fd_ = -1, other.size_ = other.pos_ = 0, other.window_ = nullptr;
+    return *this;
+}
+
+bool mappedfile::valid() const noexcept { return fd_ >= 0; }
+
+bool mappedfile::open(const char* fname, std::size_t window_sz) {
+    close();
+    const int fd = ::open(fname, O_LARGEFILE | O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat sb;
+    if (::fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    // window size must be a multiple of page size
+    const std::size_t page_sz = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    window_limit_ = std::max<std::size_t>((window_sz / page_sz) * page_sz, page_sz);
+    fd_ = fd, size_ = static_cast<std::uint64_t>(sb.st_size);
+    return true;
+}
+
+bool mappedfile::open(const wchar_t* fname, std::size_t window_sz) {
+    return open(from_wide_to_utf8(fname).c_str(), window_sz);
+}
+
+void mappedfile::close() noexcept {
+    if (fd_ < 0) { return; }
+    unmap_window();
+    ::close(fd_);
+    fd_ = -1, size_ = pos_ = 0;
+}
+
+void mappedfile::unmap_window() noexcept {
+    if (!window_) { return; }
+    ::munmap(window_, window_sz_);
+    window_ = nullptr;
+}
+
+void* mappedfile::map(std::size_t& sz, bool wr) {
+    if (fd_ < 0 || wr || pos_ >= size_) { return nullptr; }
+    if (!window_ || pos_ < window_pos_ || pos_ - window_pos_ >= window_sz_) {
+        unmap_window();
+        window_pos_ = pos_ - pos_ % window_limit_;
+        window_sz_ = static_cast<std::size_t>(std::min<std::uint64_t>(window_limit_, size_ - window_pos_));
+        void* p = ::mmap64(nullptr, window_sz_, PROT_READ, MAP_PRIVATE, fd_, static_cast<off64_t>(window_pos_));
+        if (p == MAP_FAILED) { return nullptr; }
+        ::madvise(p, window_sz_, MADV_SEQUENTIAL);
+        window_ = p;
+    }
+    const std::size_t offset = static_cast<std::size_t>(pos_ - window_pos_);
+    sz = window_sz_ - offset;
+    return static_cast<std::uint8_t*>(window_) + offset;
+}
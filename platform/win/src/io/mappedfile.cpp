@@ -0,0 +1,93 @@
+#include "uxs/io/mappedfile.h"
+
+#include "uxs/string_util.h"
+
+#include <windows.h>
+
+#include <algorithm>
+
+using namespace uxs;
+
+mappedfile::mappedfile() noexcept : iodevice(iodevcaps::rdonly | iodevcaps::mappable), fd_(INVALID_HANDLE_VALUE) {}
+
+mappedfile::mappedfile(mappedfile&& other) noexcept
+    : iodevice(iodevcaps::rdonly | iodevcaps::mappable), fd_(other.fd_), mapping_(other.mapping_),
+      size_(other.size_), pos_(other.pos_), window_pos_(other.window_pos_), window_sz_(other.window_sz_),
+      window_limit_(other.window_limit_), window_(other.window_) {
+    other.fd_ = INVALID_HANDLE_VALUE, other.mapping_ = nullptr;
+    other.size_ = other.pos_ = 0, other.window_ = nullptr;
+}
+
+mappedfile& mappedfile::operator=(mappedfile&& other) noexcept {
+    if (&other == this) { return *this; }
+    close();
+    fd_ = other.fd_, mapping_ = other.mapping_, size_ = other.size_, pos_ = other.pos_;
+    window_pos_ = other.window_pos_, window_sz_ = other.window_sz_, window_limit_ = other.window_limit_;
+    window_ = other.window_;
+    other.fd_ = INVALID_HANDLE_VALUE, other.mapping_ = nullptr;
+    other.size_ = other.pos_ = 0, other.window_ = nullptr;
+    return *this;
+}
+
+bool mappedfile::valid() const noexcept { return fd_ != INVALID_HANDLE_VALUE; }
+
+bool mappedfile::open(const wchar_t* fname, std::size_t window_sz) {
+    close();
+    HANDLE fd = ::CreateFileW(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fd == INVALID_HANDLE_VALUE) { return false; }
+    LARGE_INTEGER file_sz;
+    if (!::GetFileSizeEx(fd, &file_sz)) {
+        ::CloseHandle(fd);
+        return false;
+    }
+    HANDLE mapping = NULL;
+    if (file_sz.QuadPart > 0) {  // empty files can't be mapped
+        mapping = ::CreateFileMappingW(fd, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            ::CloseHandle(fd);
+            return false;
+        }
+    }
+    // window size must be a multiple of allocation granularity
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    const std::size_t granularity = static_cast<std::size_t>(info.dwAllocationGranularity);
+    window_limit_ = std::max<std::size_t>((window_sz / granularity) * granularity, granularity);
+    fd_ = fd, mapping_ = mapping, size_ = static_cast<std::uint64_t>(file_sz.QuadPart);
+    return true;
+}
+
+bool mappedfile::open(const char* fname, std::size_t window_sz) {
+    return open(from_utf8_to_wide(fname).c_str(), window_sz);
+}
+
+void mappedfile::close() noexcept {
+    if (fd_ == INVALID_HANDLE_VALUE) { return; }
+    unmap_window();
+    if (mapping_) { ::CloseHandle(mapping_); }
+    ::CloseHandle(fd_);
+    fd_ = INVALID_HANDLE_VALUE, mapping_ = nullptr;
+    size_ = pos_ = 0;
+}
+
+void mappedfile::unmap_window() noexcept {
+    if (!window_) { return; }
+    ::UnmapViewOfFile(window_);
+    window_ = nullptr;
+}
+
+void* mappedfile::map(std::size_t& sz, bool wr) {
+    if (!mapping_ || wr || pos_ >= size_) { return nullptr; }
+    if (!window_ || pos_ < window_pos_ || pos_ - window_pos_ >= window_sz_) {
+        unmap_window();
+        window_pos_ = pos_ - pos_ % window_limit_;
+        window_sz_ = static_cast<std::size_t>(std::min<std::uint64_t>(window_limit_, size_ - window_pos_));
+        window_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, static_cast<DWORD>(window_pos_ >> 32),
+                                  static_cast<DWORD>(window_pos_), window_sz_);
+        if (!window_) { return nullptr; }
+    }
+    const std::size_t offset = static_cast<std::size_t>(pos_ - window_pos_);
+    sz = window_sz_ - offset;
+    return static_cast<std::uint8_t*>(window_) + offset;
+}
@@ -0,0 +1,327 @@
+#include "uxs/db/char_scan.h"
+
+#include "uxs/chars.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#    define UXS_CHAR_SCAN_USE_SSE2 1
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    endif
+#    include <immintrin.h>
+#    if defined(__GNUC__)
+#        define UXS_CHAR_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#    else
+#        define UXS_CHAR_SCAN_TARGET_AVX2
+#    endif
+#else
+#    define UXS_CHAR_SCAN_USE_SSE2 0
+#endif
+
+using namespace uxs;
+using namespace uxs::db;
+using namespace uxs::db::detail;
+using tbl = uxs::detail::char_tbl_t;
+
+namespace {
+
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+
+#    if defined(_MSC_VER)
+inline unsigned ctz32(std::uint32_t x) {
+    unsigned long ret;
+    _BitScanForward(&ret, x);
+    return ret;
+}
+inline unsigned popcount32(std::uint32_t x) {
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+bool detect_avx2() {
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) { return false; }
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27))) { return false; }  // OSXSAVE
+    if ((_xgetbv(0) & 6) != 6) { return false; }   // XMM and YMM states are enabled by OS
+    __cpuidex(regs, 7, 0);
+    return !!(regs[1] & (1 << 5));
+}
+#    else
+inline unsigned ctz32(std::uint32_t x) { return __builtin_ctz(x); }
+inline unsigned popcount32(std::uint32_t x) { return __builtin_popcount(x); }
+bool detect_avx2() {
+    __builtin_cpu_init();
+    return !!__builtin_cpu_supports("avx2");
+}
+#    endif
+
+const bool g_has_avx2 = detect_avx2();
+
+// Character sets: each returns a vector with `0xff` bytes on matching positions
+
+struct json_ws_set {
+    static __m128i match(__m128i v) {
+        return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        return _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))));
+    }
+};
+
+struct json_string_special_set {
+    static __m128i match(__m128i v) {
+        return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        return _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+    }
+};
+
+struct json_structural_set {
+    static __m128i match(__m128i v) {
+        const __m128i v_lc = _mm_or_si128(v, _mm_set1_epi8(0x20));  // `[` -> `{`, `]` -> `}`
+        return _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v_lc, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v_lc, _mm_set1_epi8('}'))),
+                         _mm_cmpeq_epi8(v, _mm_setzero_si128())),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        const __m256i v_lc = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v_lc, _mm256_set1_epi8('{')),
+                                            _mm256_cmpeq_epi8(v_lc, _mm256_set1_epi8('}'))),
+                            _mm256_cmpeq_epi8(v, _mm256_setzero_si256())),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))));
+    }
+};
+
+struct json_escape_set {
+    static __m128i match(__m128i v) {
+        const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);  // unsigned `v <= 0x1f`
+        return _mm_or_si128(
+            ctrl, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        const __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+        return _mm256_or_si256(ctrl, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')),
+                                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+    }
+};
+
+struct xml_special_set {
+    static __m128i match(__m128i v) {
+        return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+                            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')), _mm_cmpeq_epi8(v, _mm_set1_epi8('<'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        return _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256()),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<'))));
+    }
+};
+
+template<char Quot>
+struct xml_string_special_set {
+    static __m128i match(__m128i v) {
+        return _mm_or_si128(
+            _mm_or_si128(xml_special_set::match(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(Quot)));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        return _mm256_or_si256(
+            _mm256_or_si256(xml_special_set::match(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(Quot)));
+    }
+};
+
+struct xml_escape_set {
+    static __m128i match(__m128i v) {
+        const __m128i v_gt = _mm_or_si128(v, _mm_set1_epi8(0x02));  // `<` -> `>`
+        return _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v_gt, _mm_set1_epi8('>')), _mm_cmpeq_epi8(v, _mm_set1_epi8('&'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\"'))));
+    }
+    UXS_CHAR_SCAN_TARGET_AVX2 static __m256i match(__m256i v) {
+        const __m256i v_gt = _mm256_or_si256(v, _mm256_set1_epi8(0x02));
+        return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v_gt, _mm256_set1_epi8('>')),
+                                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&'))),
+                               _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')),
+                                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"'))));
+    }
+};
+
+// Kernels: return `true` and stop at the first character in (`Skip` == false) or not in (`Skip` == true) the set,
+// or return `false` leaving less than one block unprocessed
+
+template<typename Set, bool Skip>
+bool scan_sse2(const char*& p, const char* last) {
+    for (; last - p >= 16; p += 16) {
+        const unsigned m = static_cast<unsigned>(
+            _mm_movemask_epi8(Set::match(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))));
+        if (const unsigned stop = Skip ? ~m & 0xffff : m) {
+            p += ctz32(stop);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Set, bool Skip>
+UXS_CHAR_SCAN_TARGET_AVX2 bool scan_avx2(const char*& p, const char* last) {
+    for (; last - p >= 32; p += 32) {
+        const std::uint32_t m = static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(Set::match(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))));
+        if (const std::uint32_t stop = Skip ? ~m : m) {
+            p += ctz32(stop);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The same, but also counts `\n` characters before the stop position
+
+template<typename Set, bool Skip>
+bool scan_sse2(const char*& p, const char* last, unsigned& n_lines) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; last - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const unsigned m = static_cast<unsigned>(_mm_movemask_epi8(Set::match(v)));
+        const unsigned m_nl = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+        if (const unsigned stop = Skip ? ~m & 0xffff : m) {
+            const unsigned n = ctz32(stop);
+            n_lines += popcount32(m_nl & ((1u << n) - 1));
+            p += n;
+            return true;
+        }
+        n_lines += popcount32(m_nl);
+    }
+    return false;
+}
+
+template<typename Set, bool Skip>
+UXS_CHAR_SCAN_TARGET_AVX2 bool scan_avx2(const char*& p, const char* last, unsigned& n_lines) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; last - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const std::uint32_t m = static_cast<std::uint32_t>(_mm256_movemask_epi8(Set::match(v)));
+        const std::uint32_t m_nl = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+        if (const std::uint32_t stop = Skip ? ~m : m) {
+            const unsigned n = ctz32(stop);
+            n_lines += popcount32(m_nl & ((1u << n) - 1));
+            p += n;
+            return true;
+        }
+        n_lines += popcount32(m_nl);
+    }
+    return false;
+}
+
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+
+}  // namespace
+
+const char* uxs::db::detail::skip_json_ws(const char* first, const char* last, unsigned& n_lines) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<json_ws_set, true>(first, last, n_lines)) { return first; }
+    if (scan_sse2<json_ws_set, true>(first, last, n_lines)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last, [&n_lines](std::uint8_t ch) {
+        if (ch != '\n') { return !(tbl{}.flags()[ch] & tbl::is_json_ws); }
+        ++n_lines;
+        return false;
+    });
+}
+
+const char* uxs::db::detail::find_json_string_special(const char* first, const char* last) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<json_string_special_set, false>(first, last)) { return first; }
+    if (scan_sse2<json_string_special_set, false>(first, last)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last,
+                        [](std::uint8_t ch) { return !!(tbl{}.flags()[ch] & tbl::is_string_special); });
+}
+
+const char* uxs::db::detail::find_json_structural(const char* first, const char* last, unsigned& n_lines) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<json_structural_set, false>(first, last, n_lines)) { return first; }
+    if (scan_sse2<json_structural_set, false>(first, last, n_lines)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last, [&n_lines](char ch) {
+        switch (ch) {
+            case '\0':
+            case '\"':
+            case '/':
+            case '[':
+            case ']':
+            case '{':
+            case '}': return true;
+            case '\n': ++n_lines; break;
+            default: break;
+        }
+        return false;
+    });
+}
+
+const char* uxs::db::detail::find_json_escape(const char* first, const char* last) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<json_escape_set, false>(first, last)) { return first; }
+    if (scan_sse2<json_escape_set, false>(first, last)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last, [](std::uint8_t ch) { return ch < 0x20 || ch == '\"' || ch == '\\'; });
+}
+
+const char* uxs::db::detail::find_xml_special(const char* first, const char* last, unsigned& n_lines) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<xml_special_set, false>(first, last, n_lines)) { return first; }
+    if (scan_sse2<xml_special_set, false>(first, last, n_lines)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last, [&n_lines](std::uint8_t ch) {
+        if (ch != '\n') { return !!(tbl{}.flags()[ch] & tbl::is_xml_special); }
+        ++n_lines;
+        return false;
+    });
+}
+
+const char* uxs::db::detail::find_xml_string_special(const char* first, const char* last, char quot) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (quot == '\"') {
+        if (g_has_avx2 && scan_avx2<xml_string_special_set<'\"'>, false>(first, last)) { return first; }
+        if (scan_sse2<xml_string_special_set<'\"'>, false>(first, last)) { return first; }
+    } else {
+        if (g_has_avx2 && scan_avx2<xml_string_special_set<'\''>, false>(first, last)) { return first; }
+        if (scan_sse2<xml_string_special_set<'\''>, false>(first, last)) { return first; }
+    }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    const char other_quot = quot == '\"' ? '\'' : '\"';
+    return std::find_if(first, last, [other_quot](std::uint8_t ch) {
+        return !!(tbl{}.flags()[ch] & tbl::is_xml_string_special) && ch != other_quot;
+    });
+}
+
+const char* uxs::db::detail::find_xml_escape(const char* first, const char* last) noexcept {
+#if UXS_CHAR_SCAN_USE_SSE2 != 0
+    if (g_has_avx2 && scan_avx2<xml_escape_set, false>(first, last)) { return first; }
+    if (scan_sse2<xml_escape_set, false>(first, last)) { return first; }
+#endif  // UXS_CHAR_SCAN_USE_SSE2 != 0
+    return std::find_if(first, last, [](char ch) {
+        switch (ch) {
+            case '&':
+            case '<':
+            case '>':
+            case '\'':
+            case '\"': return true;
+            default: break;
+        }
+        return false;
+    });
+}
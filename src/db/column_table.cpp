@@ -0,0 +1,206 @@
+#include "uxs/db/column_table.h"
+
+#include <bitset>
+#include <unordered_map>
+
+using namespace uxs;
+using namespace uxs::db;
+
+namespace {
+
+enum : unsigned { kind_bool = 1, kind_integer = 2, kind_double = 4, kind_string = 8, kind_other = 16 };
+
+unsigned value_kind(const basic_value<char>& x) {
+    switch (x.type()) {
+        case dtype::null: return 0;
+        case dtype::boolean: return kind_bool;
+        case dtype::integer:
+        case dtype::unsigned_integer:
+        case dtype::long_integer: return kind_integer;
+        case dtype::unsigned_long_integer: return x.is_int64() ? kind_integer : kind_other;
+        case dtype::double_precision: return kind_double;
+        case dtype::string: return kind_string;
+        default: return kind_other;
+    }
+}
+
+column_type column_type_of(unsigned kinds) {
+    switch (kinds) {
+        case 0: return column_type::null;
+        case kind_bool: return column_type::boolean;
+        case kind_integer: return column_type::integer;
+        case kind_double:
+        case kind_integer | kind_double: return column_type::double_precision;
+        case kind_string: return column_type::string;
+        default: return column_type::value;
+    }
+}
+
+}  // namespace
+
+std::size_t column::valid_count() const noexcept {
+    std::size_t count = 0;
+    for (const std::uint64_t word : validity_) { count += std::bitset<64>(word).count(); }
+    return count;
+}
+
+namespace {
+basic_value<char> int64_to_value(std::int64_t i) {
+    if (i >= std::numeric_limits<std::int32_t>::min() && i <= std::numeric_limits<std::int32_t>::max()) {
+        return static_cast<std::int32_t>(i);
+    }
+    return i;
+}
+}  // namespace
+
+basic_value<char> column::operator[](std::size_t row) const {
+    if (!is_valid(row)) { return {}; }
+    switch (type_) {
+        case column_type::boolean: return bools_[row] != 0;
+        case column_type::integer: return int64_to_value(ints_[row]);
+        case column_type::double_precision: return is_integral(row) ? int64_to_value(ints_[row]) : doubles_[row];
+        case column_type::string: return string_at(row);
+        case column_type::value: return values_[row];
+        default: return {};
+    }
+}
+
+// --------------------------
+
+est::optional<basic_value<char>> row_view::find(std::string_view key) const {
+    const column* col = table_->find(key);
+    if (!col || !col->is_present(row_)) { return est::nullopt(); }
+    return (*col)[row_];
+}
+
+basic_value<char> row_view::to_value() const {
+    basic_value<char> result = make_record();
+    for (std::size_t i = 0; i < size(); ++i) {
+        const column& col = table_->col(i);
+        if (col.is_present(row_)) { result.emplace(col.name(), col[row_]); }
+    }
+    return result;
+}
+
+// --------------------------
+
+column_table column_table::from_value(const basic_value<char>& v) {
+    if (!v.is_array()) { throw database_error("not an array"); }
+    const auto rows = v.as_array();
+    column_table table;
+    table.row_count_ = rows.size();
+
+    // columns and their types; record keys stay valid while `v` is alive
+    std::unordered_map<std::string_view, std::size_t> index;
+    std::vector<unsigned> kinds;
+    for (const auto& r : rows) {
+        if (!r.is_record()) { throw database_error("not a record"); }
+        for (const auto& item : r.as_record()) {
+            const auto result = index.emplace(item.key(), table.columns_.size());
+            if (result.second) {
+                table.columns_.emplace_back();
+                table.columns_.back().name_ = std::string(item.key());
+                kinds.push_back(0);
+            }
+            kinds[result.first->second] |= value_kind(item.value());
+        }
+    }
+
+    std::vector<column*> string_columns;
+    for (std::size_t i = 0; i < table.columns_.size(); ++i) {
+        column& col = table.columns_[i];
+        col.type_ = column_type_of(kinds[i]);
+        col.size_ = rows.size();
+        col.validity_.resize((rows.size() + 63) >> 6);
+        col.presence_.resize((rows.size() + 63) >> 6);
+        switch (col.type_) {
+            case column_type::boolean: col.bools_.resize(rows.size()); break;
+            case column_type::integer: col.ints_.resize(rows.size()); break;
+            case column_type::double_precision: {
+                col.doubles_.resize(rows.size());
+                if (kinds[i] & kind_integer) {
+                    // integral values are kept exactly besides their floating-point images
+                    col.ints_.resize(rows.size());
+                    col.integral_.resize((rows.size() + 63) >> 6);
+                }
+            } break;
+            case column_type::string: {
+                col.offsets_.resize(rows.size() + 1);
+                string_columns.push_back(&col);
+            } break;
+            case column_type::value: col.values_.resize(rows.size()); break;
+            default: break;
+        }
+    }
+
+    // the last of equal keys of a record wins
+    for (std::size_t row = 0; row < rows.size(); ++row) {
+        const std::uint64_t bit = std::uint64_t(1) << (row & 63);
+        for (const auto& item : rows[row].as_record()) {
+            column& col = table.columns_[index.find(item.key())->second];
+            const auto& x = item.value();
+            col.presence_[row >> 6] |= bit;
+            if (!col.integral_.empty()) { col.integral_[row >> 6] &= ~bit; }
+            if (x.is_null()) {
+                col.validity_[row >> 6] &= ~bit;
+                switch (col.type_) {
+                    case column_type::boolean: col.bools_[row] = 0; break;
+                    case column_type::integer: col.ints_[row] = 0; break;
+                    case column_type::double_precision: {
+                        col.doubles_[row] = 0;
+                        if (!col.ints_.empty()) { col.ints_[row] = 0; }
+                    } break;
+                    case column_type::string: col.chars_.resize(static_cast<std::size_t>(col.offsets_[row])); break;
+                    case column_type::value: col.values_[row] = basic_value<char>(); break;
+                    default: break;
+                }
+                continue;
+            }
+            col.validity_[row >> 6] |= bit;
+            switch (col.type_) {
+                case column_type::boolean: col.bools_[row] = x.as_bool() ? 1 : 0; break;
+                case column_type::integer: col.ints_[row] = x.as_int64(); break;
+                case column_type::double_precision: {
+                    col.doubles_[row] = x.as_double();
+                    if (value_kind(x) == kind_integer) {
+                        col.ints_[row] = x.as_int64();
+                        col.integral_[row >> 6] |= bit;
+                    } else if (!col.ints_.empty()) {
+                        col.ints_[row] = 0;
+                    }
+                } break;
+                case column_type::string: {
+                    col.chars_.resize(static_cast<std::size_t>(col.offsets_[row]));
+                    const std::string_view sv = x.as_string_view();
+                    col.chars_.append(sv.data(), sv.size());
+                } break;
+                case column_type::value: col.values_[row] = x; break;
+                default: UXS_UNREACHABLE_CODE;
+            }
+        }
+        for (column* col : string_columns) { col->offsets_[row + 1] = col->chars_.size(); }
+    }
+
+    table.sorted_.resize(table.columns_.size());
+    for (std::size_t i = 0; i < table.sorted_.size(); ++i) { table.sorted_[i] = i; }
+    std::sort(table.sorted_.begin(), table.sorted_.end(), [&table](std::size_t lhv, std::size_t rhv) {
+        return table.columns_[lhv].name_ < table.columns_[rhv].name_;
+    });
+    return table;
+}
+
+const column* column_table::find(std::string_view name) const noexcept {
+    const auto it = std::lower_bound(sorted_.begin(), sorted_.end(), name, [this](std::size_t i, std::string_view key) {
+        return std::string_view(columns_[i].name_) < key;
+    });
+    return it != sorted_.end() && columns_[*it].name_ == name ? &columns_[*it] : nullptr;
+}
+
+basic_value<char> column_table::to_value() const {
+    // records with the same keys share them
+    shape_table shapes;
+    basic_value<char> result = make_array();
+    result.reserve(row_count_);
+    for (std::size_t i = 0; i < row_count_; ++i) { result.emplace_back(row(i).to_value()).share_keys(shapes); }
+    return result;
+}
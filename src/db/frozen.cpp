@@ -0,0 +1,299 @@
+#include "uxs/impl/db/frozen_impl.h"
+
+#include <algorithm>
+
+using namespace uxs;
+using namespace uxs::db;
+
+namespace {
+
+const char g_frozen_magic[8] = {'U', 'X', 'S', 'F', 'R', 'O', 'Z', '1'};
+const std::uint64_t g_frozen_bom = 0x0102030405060708ull;
+const std::size_t g_frozen_header_size = db::detail::frozen_writer::header_size;
+static_assert(g_frozen_header_size == sizeof(g_frozen_magic) + sizeof(g_frozen_bom) + sizeof(std::uint64_t),
+              "invalid frozen header size");
+
+basic_value<char> scalar_value(dtype type, std::uint64_t data) {
+    switch (type) {
+        case dtype::boolean: return data != 0;
+        case dtype::integer: return static_cast<std::int32_t>(data);
+        case dtype::unsigned_integer: return static_cast<std::uint32_t>(data);
+        case dtype::long_integer: return static_cast<std::int64_t>(data);
+        case dtype::unsigned_long_integer: return data;
+        case dtype::double_precision: {
+            double f = 0;
+            std::memcpy(&f, &data, sizeof(f));
+            return f;
+        } break;
+        default: return {};
+    }
+}
+
+// Checks the header and the root node, and all nodes reachable from the root if `check_nodes` is `true`: a node must
+// lie entirely in front of its parent node, so strings and child slots are never read out of the image, and the check
+// can't loop
+const db::detail::frozen_slot_t& check_frozen_image(const void* data, std::size_t sz, bool check_nodes) {
+    const auto* base = static_cast<const std::uint8_t*>(data);
+    // the root slot is at the end of the image, so the size must keep it aligned
+    if (sz < g_frozen_header_size + sizeof(db::detail::frozen_slot_t) || (sz & 7) ||
+        (reinterpret_cast<std::uintptr_t>(base) & 7) || std::memcmp(base, g_frozen_magic, sizeof(g_frozen_magic)) != 0) {
+        throw database_error("invalid frozen value");
+    }
+    if (std::memcmp(base + sizeof(g_frozen_magic), &g_frozen_bom, sizeof(g_frozen_bom)) != 0) {
+        throw database_error("frozen value has different byte order");
+    }
+    if (*reinterpret_cast<const std::uint64_t*>(base + g_frozen_header_size - sizeof(std::uint64_t)) != sz) {
+        throw database_error("frozen value is truncated or has invalid size");
+    }
+    const std::uint64_t root_pos = sz - sizeof(db::detail::frozen_slot_t);
+    const auto& root = *reinterpret_cast<const db::detail::frozen_slot_t*>(base + root_pos);
+
+    struct stack_item_t {
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint64_t index;
+        bool is_record;
+    };
+
+    std::vector<stack_item_t> stack;
+
+    const auto node_size = [base](std::uint64_t offset, std::uint64_t limit) {
+        if (offset < g_frozen_header_size || (offset & 7) || offset >= limit ||
+            limit - offset < sizeof(std::uint64_t)) {
+            throw database_error("invalid frozen value");
+        }
+        return *reinterpret_cast<const std::uint64_t*>(base + offset);
+    };
+
+    const auto check_string = [base, &node_size](std::uint64_t offset, std::uint64_t limit) {
+        const std::uint64_t len = node_size(offset, limit);
+        if (len >= limit - offset - sizeof(std::uint64_t) || base[offset + sizeof(std::uint64_t) + len] != 0) {
+            throw database_error("invalid frozen value");
+        }
+    };
+
+    // checks the slot of the node at `limit`, pushes arrays and records to the stack
+    const auto visit = [base, &stack, &node_size, &check_string](const db::detail::frozen_slot_t& slot,
+                                                                  std::uint64_t limit) {
+        switch (static_cast<dtype>(slot.type)) {
+            case dtype::null:
+            case dtype::boolean:
+            case dtype::integer:
+            case dtype::unsigned_integer:
+            case dtype::long_integer:
+            case dtype::unsigned_long_integer:
+            case dtype::double_precision: break;
+            case dtype::string: check_string(slot.data, limit); break;
+            case dtype::array: {
+                const std::uint64_t count = node_size(slot.data, limit);
+                if (count > (limit - slot.data - sizeof(std::uint64_t)) / sizeof(db::detail::frozen_slot_t)) {
+                    throw database_error("invalid frozen value");
+                }
+                stack.push_back(stack_item_t{slot.data, count, 0, false});
+            } break;
+            case dtype::record: {
+                const std::uint64_t count = node_size(slot.data, limit);
+                if (count > (limit - slot.data - sizeof(std::uint64_t)) /
+                                (sizeof(db::detail::frozen_entry_t) + sizeof(std::uint64_t))) {
+                    throw database_error("invalid frozen value");
+                }
+                const auto* order = reinterpret_cast<const std::uint64_t*>(
+                    base + slot.data + sizeof(std::uint64_t) + count * sizeof(db::detail::frozen_entry_t));
+                if (std::any_of(order, order + count, [count](std::uint64_t pos) { return pos >= count; })) {
+                    throw database_error("invalid frozen value");
+                }
+                stack.push_back(stack_item_t{slot.data, count, 0, true});
+            } break;
+            default: throw database_error("invalid frozen value");
+        }
+    };
+
+    visit(root, root_pos);
+    if (!check_nodes) { return root; }
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.index == top.size) {
+            stack.pop_back();
+            continue;
+        }
+        const std::uint64_t offset = top.offset, i = top.index++;
+        const std::uint8_t* items = base + offset + sizeof(std::uint64_t);
+        if (!top.is_record) {
+            visit(reinterpret_cast<const db::detail::frozen_slot_t*>(items)[i], offset);
+            continue;
+        }
+        const auto& entry = reinterpret_cast<const db::detail::frozen_entry_t*>(items)[i];
+        check_string(entry.key, offset);
+        visit(entry.value, offset);
+    }
+    return root;
+}
+
+}  // namespace
+
+std::uint64_t db::detail::frozen_key_hash(std::string_view key) noexcept {
+    std::uint64_t h = 0xcbf29ce484222325ull;  // 64-bit FNV-1a
+    for (const char ch : key) { h = (h ^ static_cast<std::uint8_t>(ch)) * 0x100000001b3ull; }
+    return h;
+}
+
+// --------------------------
+
+db::detail::frozen_writer::frozen_writer(biobuf& out, std::uint64_t image_size)
+    : out_(out), image_size_(image_size) {
+    write(g_frozen_magic, sizeof(g_frozen_magic));
+    write(&g_frozen_bom, sizeof(g_frozen_bom));
+    write(&image_size_, sizeof(image_size_));
+}
+
+void db::detail::frozen_writer::write(const void* data, std::size_t sz) {
+    out_.write(est::as_span(static_cast<const std::uint8_t*>(data), sz));
+    pos_ += sz;
+}
+
+std::uint64_t db::detail::frozen_writer::write_string(std::string_view s) {
+    const std::uint64_t offset = pos_, sz = s.size();
+    const std::uint8_t padding[8] = {};
+    write(&sz, sizeof(sz));
+    write(s.data(), s.size());
+    write(padding, sizeof(padding) - s.size() % sizeof(padding));  // at least one zero
+    return offset;
+}
+
+std::uint64_t db::detail::frozen_writer::write_array(const std::vector<frozen_entry_t>& elements) {
+    const std::uint64_t offset = pos_, sz = elements.size();
+    write(&sz, sizeof(sz));
+    for (const auto& el : elements) { write(&el.value, sizeof(el.value)); }
+    return offset;
+}
+
+std::uint64_t db::detail::frozen_writer::write_record(const std::vector<frozen_entry_t>& entries) {
+    const std::uint64_t offset = pos_, sz = entries.size();
+    std::vector<std::uint64_t> sorted(entries.size());
+    for (std::size_t i = 0; i < sorted.size(); ++i) { sorted[i] = i; }
+    std::stable_sort(sorted.begin(), sorted.end(), [&entries](std::uint64_t lhv, std::uint64_t rhv) {
+        return entries[lhv].hash < entries[rhv].hash;
+    });
+    std::vector<std::uint64_t> order(entries.size());
+    write(&sz, sizeof(sz));
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        order[sorted[i]] = i;
+        write(&entries[sorted[i]], sizeof(frozen_entry_t));
+    }
+    if (!order.empty()) { write(order.data(), order.size() * sizeof(std::uint64_t)); }
+    return offset;
+}
+
+void db::detail::frozen_writer::finish(const frozen_slot_t& root) {
+    write(&root, sizeof(root));
+    assert(pos_ == image_size_);
+    if (!out_) { throw database_error("can't write frozen value"); }
+}
+
+// --------------------------
+
+frozen_value frozen_value::open(const void* data, std::size_t sz) {
+    return frozen_value(static_cast<const std::uint8_t*>(data), check_frozen_image(data, sz, false));
+}
+
+frozen_value frozen_value::open_checked(const void* data, std::size_t sz) {
+    return frozen_value(static_cast<const std::uint8_t*>(data), check_frozen_image(data, sz, true));
+}
+
+bool frozen_value::as_bool() const {
+    if (type_ == dtype::string) { return basic_value<char>(as_string_view()).as_bool(); }
+    return scalar_value(type_, data_).as_bool();
+}
+
+std::int64_t frozen_value::as_int64() const {
+    if (type_ == dtype::string) { return basic_value<char>(as_string_view()).as_int64(); }
+    return scalar_value(type_, data_).as_int64();
+}
+
+std::uint64_t frozen_value::as_uint64() const {
+    if (type_ == dtype::string) { return basic_value<char>(as_string_view()).as_uint64(); }
+    return scalar_value(type_, data_).as_uint64();
+}
+
+double frozen_value::as_double() const {
+    if (type_ == dtype::string) { return basic_value<char>(as_string_view()).as_double(); }
+    return scalar_value(type_, data_).as_double();
+}
+
+std::string_view frozen_value::as_string_view() const {
+    if (type_ == dtype::string) { return string_at(data_); }
+    throw database_error("bad value conversion");
+}
+
+frozen_value frozen_value::operator[](std::size_t i) const {
+    if (type_ == dtype::array) { return frozen_value(base_, array_slots()[i]); }
+    if (type_ != dtype::record) { throw database_error("bad value conversion"); }
+    const auto* order = reinterpret_cast<const std::uint64_t*>(record_entries() + node_header());
+    return frozen_value(base_, record_entries()[order[i]].value);
+}
+
+std::string_view frozen_value::key(std::size_t i) const {
+    if (type_ != dtype::record) { throw database_error("bad value conversion"); }
+    const auto* order = reinterpret_cast<const std::uint64_t*>(record_entries() + node_header());
+    return string_at(record_entries()[order[i]].key);
+}
+
+est::optional<frozen_value> frozen_value::find(std::string_view key) const noexcept {
+    if (type_ != dtype::record) { return est::nullopt(); }
+    const std::uint64_t hash = detail::frozen_key_hash(key);
+    const detail::frozen_entry_t* last = record_entries() + node_header();
+    for (const auto* entry = std::lower_bound(
+             record_entries(), last, hash,
+             [](const detail::frozen_entry_t& entry, std::uint64_t hash) { return entry.hash < hash; });
+         entry != last && entry->hash == hash; ++entry) {
+        if (string_at(entry->key) == key) { return frozen_value(base_, entry->value); }
+    }
+    return est::nullopt();
+}
+
+basic_value<char> frozen_value::thaw() const {
+    struct stack_item_t {
+        frozen_value src;
+        std::size_t index;
+        basic_value<char>* dst;
+    };
+
+    // makes scalar or string value, or empty array or record
+    const auto make_value = [](const frozen_value& x) -> basic_value<char> {
+        switch (x.type_) {
+            case dtype::string: return x.as_string_view();
+            case dtype::array: {
+                basic_value<char> result = make_array();
+                result.reserve(x.size());
+                return result;
+            } break;
+            case dtype::record: return make_record();
+            default: return scalar_value(x.type_, x.data_);
+        }
+    };
+
+    basic_value<char> result = make_value(*this);
+    std::vector<stack_item_t> stack;
+    if (is_array() || is_record()) { stack.push_back(stack_item_t{*this, 0, &result}); }
+
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.index == top.src.size()) {
+            stack.pop_back();
+            continue;
+        }
+        const std::size_t i = top.index++;
+        const frozen_value x = top.src[i];
+        basic_value<char>& v = top.src.is_record() ? top.dst->emplace(top.src.key(i), make_value(x)).value() :
+                                                     top.dst->emplace_back(make_value(x));
+        if (x.is_array() || x.is_record()) { stack.push_back(stack_item_t{x, 0, &v}); }
+    }
+
+    return result;
+}
+
+namespace uxs {
+namespace db {
+template UXS_EXPORT void freeze(biobuf& out, const basic_value<char>& v);
+}  // namespace db
+}  // namespace uxs
@@ -1,3 +1,4 @@
+#include "uxs/db/char_scan.h"
 #include "uxs/impl/db/json_impl.h"
 
 namespace lex_detail {
@@ -7,11 +8,57 @@ namespace lex_detail {
 #include "json_lex_analyzer.inl"
 }
 
+#include <cstring>
+
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#    define UXS_JSON_USE_SWAR_DIGITS
+#endif
+
+namespace {
+
+// Converts exactly 8 decimal digits
+inline std::uint32_t decode_8_digits(const char* p) noexcept {
+#if defined(UXS_JSON_USE_SWAR_DIGITS)
+    // digits are packed pairwise: to 2-digit, then to 4-digit, and then to 8-digit numbers
+    std::uint64_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    v -= 0x3030303030303030ull;
+    v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffull;
+    v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffull;
+    return static_cast<std::uint32_t>(v * 10000 + (v >> 32));
+#else   // defined(UXS_JSON_USE_SWAR_DIGITS)
+    std::uint32_t v = 0;
+    for (const char* last = p + 8; p != last; ++p) { v = 10 * v + static_cast<unsigned>(*p - '0'); }
+    return v;
+#endif  // defined(UXS_JSON_USE_SWAR_DIGITS)
+}
+
+// Converts decimal digits to unsigned 64-bit integer, returns `false` on overflow
+inline bool decode_integer(const char* p, std::size_t len, std::uint64_t& u64) noexcept {
+    if (len > 20) { return false; }
+    const std::size_t len0 = len < 20 ? len : 19;  // up to 19 digits never overflow
+    std::uint64_t v = 0;
+    const char* last = p + len0;
+    for (; last - p >= 8; p += 8) { v = 100000000 * v + decode_8_digits(p); }
+    for (; p != last; ++p) { v = 10 * v + static_cast<unsigned>(*p - '0'); }
+    if (len == 20) {
+        const unsigned dig = static_cast<unsigned>(*p - '0');
+        if (v > (std::numeric_limits<std::uint64_t>::max() - dig) / 10) { return false; }
+        v = 10 * v + dig;
+    }
+    u64 = v;
+    return true;
+}
+
+}  // namespace
+
 namespace uxs {
 namespace db {
 namespace json {
 
-detail::lexer::lexer(ibuf& in) : in(in) { stack.push_back(lex_detail::sc_initial); }
+detail::lexer::lexer(ibuf& in, monotonic_arena* arena) : in(in), arena(arena) {
+    stack.push_back(lex_detail::sc_initial);
+}
 
 token_t detail::lexer::lex(std::string_view& lval) {
     unsigned surrogate = 0;
@@ -24,11 +71,7 @@ token_t detail::lexer::lex(std::string_view& lval) {
             const char* curr = in.curr();
             if (tbl{}.flags()[static_cast<std::uint8_t>(*curr)] & tbl::is_json_ws) {  // skip whitespaces
                 if (*curr == '\n') { ++ln; }
-                curr = std::find_if(curr + 1, in.last(), [this](std::uint8_t ch) {
-                    if (ch != '\n') { return !(tbl{}.flags()[ch] & tbl::is_json_ws); }
-                    ++ln;
-                    return false;
-                });
+                curr = db::detail::skip_json_ws(curr + 1, in.last(), ln);
                 in.setpos(curr - in.first());
                 if (!in.avail()) { continue; }
             }
@@ -44,8 +87,7 @@ token_t detail::lexer::lex(std::string_view& lval) {
             }
         } else {  // read string
             const char* curr0 = in.curr();
-            const char* curr = std::find_if(
-                curr0, in.last(), [](std::uint8_t ch) { return !!(tbl{}.flags()[ch] & tbl::is_string_special); });
+            const char* curr = db::detail::find_json_string_special(curr0, in.last());
 
             in.setpos(curr - in.first());
             if (!in.avail()) {
@@ -58,7 +100,13 @@ token_t detail::lexer::lex(std::string_view& lval) {
                     lval = to_string_view(curr0, curr);
                 } else {
                     str.append(curr0, curr);
-                    lval = std::string_view(str.data(), str.size());
+                    if (arena) {
+                        char* p = static_cast<char*>(arena->allocate(str.size(), 1));
+                        std::memcpy(p, str.data(), str.size());
+                        lval = std::string_view(p, str.size());
+                    } else {
+                        lval = std::string_view(str.data(), str.size());
+                    }
                     str.clear();  // it resets end pointer, but retains the contents
                 }
                 in.advance(1);
@@ -158,14 +206,25 @@ token_t detail::lexer::lex(std::string_view& lval) {
             case lex_detail::pat_false: return token_t::false_value;
             case lex_detail::pat_decimal: {
                 lval = std::string_view(lexeme, llen);
-                return token_t::integer_number;
+                if (decode_integer(lexeme, llen, num.u64)) { return token_t::integer_number; }
+                // too big integer - treat as double
+                num.dbl = from_string<double>(lval);
+                return token_t::floating_point_number;
             } break;
             case lex_detail::pat_neg_decimal: {
                 lval = std::string_view(lexeme, llen);
-                return token_t::negative_integer_number;
+                std::uint64_t u64 = 0;
+                if (decode_integer(lexeme + 1, llen - 1, u64) &&
+                    u64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) + 1) {
+                    num.i64 = u64 ? -static_cast<std::int64_t>(u64 - 1) - 1 : 0;
+                    return token_t::negative_integer_number;
+                }
+                num.dbl = from_string<double>(lval);
+                return token_t::floating_point_number;
             } break;
             case lex_detail::pat_real: {
                 lval = std::string_view(lexeme, llen);
+                num.dbl = from_string<double>(lval);
                 return token_t::floating_point_number;
             } break;
 
@@ -205,8 +264,68 @@ token_t detail::lexer::lex(std::string_view& lval) {
     return token_t::eof;
 }
 
+void detail::lexer::skip_subtree() {
+    // skips raw characters till matching `]` or `}`, only brackets, strings and comments are recognized
+    unsigned depth = 1;
+    while (true) {
+        const char* curr = db::detail::find_json_structural(in.curr(), in.last(), ln);
+        in.setpos(curr - in.first());
+        if (!in.avail()) {
+            if (in.peek() == ibuf::traits_type::eof()) { break; }
+            continue;
+        }
+        in.advance(1);
+        switch (*curr) {
+            case '[':
+            case '{': ++depth; break;
+            case ']':
+            case '}': {
+                if (--depth == 0) { return; }
+            } break;
+            case '\"': {  // skip string
+                while (true) {
+                    curr = db::detail::find_json_string_special(in.curr(), in.last());
+                    in.setpos(curr - in.first());
+                    if (!in.avail()) {
+                        if (in.peek() == ibuf::traits_type::eof()) { break; }
+                        continue;
+                    }
+                    in.advance(1);
+                    if (*curr == '\"') { break; }
+                    if (*curr != '\\' || in.get() == ibuf::traits_type::eof()) {
+                        throw database_error(to_string(ln) + ": unterminated string");
+                    }
+                }
+            } break;
+            case '/': {  // skip comment
+                int ch = in.peek();
+                if (ch == '/') {
+                    do { ch = in.get(); } while (ch != ibuf::traits_type::eof() && ch != 0 && ch != '\n');
+                    if (ch == '\n') { ++ln; }
+                } else if (ch == '*') {
+                    bool star = false;
+                    in.advance(1);
+                    while (true) {
+                        ch = in.get();
+                        if (ch == ibuf::traits_type::eof() || ch == 0) {
+                            throw database_error(to_string(ln) + ": unterminated C-style comment");
+                        }
+                        if (ch == '\n') { ++ln; }
+                        if (star && ch == '/') { break; }
+                        star = (ch == '*');
+                    }
+                }
+            } break;
+            default: throw database_error(to_string(ln) + ": unexpected end of file");
+        }
+    }
+    throw database_error(to_string(ln) + ": unexpected end of file");
+}
+
 template UXS_EXPORT basic_value<char> read(ibuf&, const std::allocator<char>&);
 template UXS_EXPORT basic_value<wchar_t> read(ibuf&, const std::allocator<wchar_t>&);
+template UXS_EXPORT basic_value<char> read(ibuf&, shape_table&, const std::allocator<char>&);
+template UXS_EXPORT basic_value<wchar_t> read(ibuf&, basic_shape_table<wchar_t>&, const std::allocator<wchar_t>&);
 template UXS_EXPORT void write(membuffer& out, const basic_value<char>&);
 template UXS_EXPORT void write(membuffer& out, const basic_value<wchar_t>&);
 template UXS_EXPORT void write(wmembuffer& out, const basic_value<char>&);
@@ -215,6 +334,8 @@ template UXS_EXPORT void write_formatted(membuffer& out, const basic_value<char>
 template UXS_EXPORT void write_formatted(membuffer& out, const basic_value<wchar_t>&, json_fmt_opts, unsigned);
 template UXS_EXPORT void write_formatted(wmembuffer& out, const basic_value<char>&, json_fmt_opts, unsigned);
 template UXS_EXPORT void write_formatted(wmembuffer& out, const basic_value<wchar_t>&, json_fmt_opts, unsigned);
+template class basic_writer<char>;
+template class basic_writer<wchar_t>;
 }  // namespace json
 }  // namespace db
 }  // namespace uxs
@@ -0,0 +1,14 @@
+#include "uxs/impl/db/json_patch_impl.h"
+
+namespace uxs {
+namespace db {
+namespace json {
+template UXS_EXPORT basic_value<char> diff(const basic_value<char>&, const basic_value<char>&);
+template UXS_EXPORT basic_value<wchar_t> diff(const basic_value<wchar_t>&, const basic_value<wchar_t>&);
+template UXS_EXPORT void apply_patch(basic_value<char>&, const basic_value<char>&);
+template UXS_EXPORT void apply_patch(basic_value<wchar_t>&, const basic_value<wchar_t>&);
+template UXS_EXPORT bool unordered_equal(const basic_value<char>&, const basic_value<char>&);
+template UXS_EXPORT bool unordered_equal(const basic_value<wchar_t>&, const basic_value<wchar_t>&);
+}  // namespace json
+}  // namespace db
+}  // namespace uxs
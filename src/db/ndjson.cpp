@@ -0,0 +1,241 @@
+#include "uxs/db/ndjson.h"
+
+#include "uxs/db/char_scan.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace uxs;
+using namespace uxs::db;
+using namespace uxs::db::json;
+
+namespace {
+
+struct ndjson_chunk_t {
+    enum class state_t { free = 0, queued, done } state = state_t::free;
+    bool is_view = false;
+    std::uint64_t ln = 0;
+    std::string_view text;
+    std::vector<char> buf;
+};
+
+class ndjson_reader {
+ public:
+    ndjson_reader(ibuf& in, const ndjson_opts& opts, const json::detail::ndjson_work_fn& fn_work,
+                  const json::detail::ndjson_deliver_fn& fn_deliver)
+        : in_(in), chunk_size_(std::max<std::size_t>(opts.chunk_size, 1)), ordered_(opts.ordered),
+          fn_work_(fn_work), fn_deliver_(fn_deliver), chunks_(json::detail::ndjson_slot_count(opts)) {}
+
+    void run(unsigned thread_count);
+
+ private:
+    ibuf& in_;
+    std::size_t chunk_size_;
+    bool ordered_;
+    const json::detail::ndjson_work_fn& fn_work_;
+    const json::detail::ndjson_deliver_fn& fn_deliver_;
+    std::vector<ndjson_chunk_t> chunks_;
+    std::vector<char> carry_;
+    std::uint64_t ln_ = 1;
+    std::size_t read_seq_ = 0;
+    std::size_t deliver_seq_ = 0;
+    std::size_t views_in_flight_ = 0;
+    bool finished_ = false;
+    std::exception_ptr error_;
+    std::vector<std::size_t> queue_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+
+    void worker();
+    ndjson_chunk_t* find_chunk(ndjson_chunk_t::state_t state, std::size_t seq);
+    bool read_chunk(ndjson_chunk_t& chunk);
+    void wait_for_views();
+};
+
+void ndjson_reader::run(unsigned thread_count) {
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count);
+    const auto stop = [this, &workers]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& t : workers) { t.join(); }
+    };
+
+    try {
+        for (unsigned n = 0; n < thread_count; ++n) { workers.emplace_back([this] { worker(); }); }
+
+        bool eof = false;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!error_) {
+            if (ndjson_chunk_t* chunk = find_chunk(ndjson_chunk_t::state_t::done, deliver_seq_)) {
+                lock.unlock();
+                fn_deliver_(chunk - chunks_.data());
+                lock.lock();
+                chunk->state = ndjson_chunk_t::state_t::free;
+                ++deliver_seq_;
+                continue;
+            }
+            if (!eof) {
+                if (ndjson_chunk_t* chunk = find_chunk(ndjson_chunk_t::state_t::free, read_seq_)) {
+                    lock.unlock();
+                    eof = !read_chunk(*chunk);
+                    lock.lock();
+                    if (!eof) {
+                        chunk->state = ndjson_chunk_t::state_t::queued;
+                        queue_.push_back(chunk - chunks_.data());
+                        ++read_seq_;
+                        work_cv_.notify_one();
+                    }
+                    continue;
+                }
+            } else if (deliver_seq_ == read_seq_) {
+                break;
+            }
+            done_cv_.wait(lock);
+        }
+    } catch (...) {
+        stop();
+        throw;
+    }
+
+    stop();
+    if (error_) { std::rethrow_exception(error_); }
+}
+
+ndjson_chunk_t* ndjson_reader::find_chunk(ndjson_chunk_t::state_t state, std::size_t seq) {
+    // in ordered mode chunk with sequential number `seq` uses slot `seq % slot_count`
+    if (ordered_) {
+        ndjson_chunk_t& chunk = chunks_[seq % chunks_.size()];
+        return chunk.state == state ? &chunk : nullptr;
+    }
+    auto it = std::find_if(chunks_.begin(), chunks_.end(),
+                           [state](const ndjson_chunk_t& chunk) { return chunk.state == state; });
+    return it != chunks_.end() ? &*it : nullptr;
+}
+
+void ndjson_reader::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return finished_ || !queue_.empty(); });
+        if (finished_) { return; }
+        ndjson_chunk_t& chunk = chunks_[queue_.front()];
+        queue_.erase(queue_.begin());
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            fn_work_(&chunk - chunks_.data(), chunk.text, chunk.ln);
+        } catch (...) { error = std::current_exception(); }
+        lock.lock();
+        if (error && !error_) { error_ = error; }
+        if (chunk.is_view) { --views_in_flight_; }
+        chunk.state = ndjson_chunk_t::state_t::done;
+        done_cv_.notify_all();
+    }
+}
+
+void ndjson_reader::wait_for_views() {
+    // views point to the current input buffer, so it can't be refilled until they are processed
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return views_in_flight_ == 0; });
+}
+
+bool ndjson_reader::read_chunk(ndjson_chunk_t& chunk) {
+    chunk.ln = ln_;
+    if (carry_.empty()) {
+        if (!in_.avail()) {
+            wait_for_views();
+            if (in_.peek() == ibuf::traits_type::eof()) { return false; }
+        }
+        if (in_.avail() >= chunk_size_) {
+            // the whole chunk is in the input buffer (e.g. for flat or mapped input): use it without copying
+            const char* first = in_.curr();
+            const char* last = std::find(std::make_reverse_iterator(first + chunk_size_),
+                                         std::make_reverse_iterator(first), '\n')
+                                   .base();
+            if (last == first) {  // a line longer than chunk
+                last = std::find(first + chunk_size_, in_.last(), '\n');
+                if (last != in_.last()) { ++last; }
+            }
+            if (*(last - 1) == '\n') {
+                chunk.text = std::string_view(first, last - first);
+                chunk.is_view = true;
+                in_.advance(last - first);
+                ln_ += std::count(first, last, '\n');
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++views_in_flight_;
+                return true;
+            }
+        }
+    }
+
+    chunk.is_view = false;
+    chunk.buf.swap(carry_);
+    carry_.clear();
+    while (true) {
+        if (!in_.avail()) {
+            wait_for_views();
+            if (in_.peek() == ibuf::traits_type::eof()) { break; }
+        }
+        if (chunk.buf.size() < chunk_size_) {
+            const std::size_t n = std::min(in_.avail(), chunk_size_ - chunk.buf.size());
+            chunk.buf.insert(chunk.buf.end(), in_.curr(), in_.curr() + n);
+            in_.advance(n);
+            if (chunk.buf.size() < chunk_size_) { continue; }
+            // cut at the last complete line
+            auto r_nl = std::find(chunk.buf.rbegin(), chunk.buf.rend(), '\n');
+            if (r_nl != chunk.buf.rend()) {
+                carry_.assign(r_nl.base(), chunk.buf.end());
+                chunk.buf.erase(r_nl.base(), chunk.buf.end());
+                break;
+            }
+        } else {  // a line longer than chunk: read till the end of line
+            const char* last = std::find(in_.curr(), in_.last(), '\n');
+            const bool eol = last != in_.last();
+            if (eol) { ++last; }
+            chunk.buf.insert(chunk.buf.end(), in_.curr(), last);
+            in_.advance(last - in_.curr());
+            if (eol) { break; }
+        }
+    }
+
+    if (chunk.buf.empty()) { return false; }
+    chunk.text = std::string_view(chunk.buf.data(), chunk.buf.size());
+    ln_ += std::count(chunk.buf.begin(), chunk.buf.end(), '\n');
+    return true;
+}
+
+}  // namespace
+
+std::size_t json::detail::ndjson_slot_count(const ndjson_opts& opts) noexcept {
+    const unsigned thread_count = opts.thread_count ? opts.thread_count :
+                                                      std::max(std::thread::hardware_concurrency(), 1u);
+    return 2 * thread_count;
+}
+
+void json::detail::read_ndjson_chunks(ibuf& in, const ndjson_opts& opts, const ndjson_work_fn& fn_work,
+                                      const ndjson_deliver_fn& fn_deliver) {
+    ndjson_reader reader(in, opts, fn_work, fn_deliver);
+    reader.run(static_cast<unsigned>(ndjson_slot_count(opts) / 2));
+}
+
+void json::detail::throw_ndjson_line_error(std::uint64_t ln, const database_error& e) {
+    // errors of the line reader start with the line number within the line, which is replaced with the line number
+    // within the input
+    std::string_view msg(e.what());
+    const std::size_t pos = msg.find(": ");
+    throw database_error(to_string(ln) + std::string(msg.substr(pos != std::string_view::npos ? pos : 0)));
+}
+
+void json::detail::check_ndjson_line_end(ibuf& in, std::uint64_t ln) {
+    unsigned n_lines = 0;
+    if (db::detail::skip_json_ws(in.curr(), in.last(), n_lines) != in.last()) {
+        throw database_error(to_string(ln) + ": unexpected characters after value");
+    }
+}
@@ -11,9 +11,13 @@ template class record_t<char, std::allocator<char>>;
 template class record_t<wchar_t, std::allocator<wchar_t>>;
 template class record_value<char, std::allocator<char>>;
 template class record_value<wchar_t, std::allocator<wchar_t>>;
+template class record_shape<char, std::allocator<char>>;
+template class record_shape<wchar_t, std::allocator<wchar_t>>;
 }  // namespace detail
 template class basic_value<char>;
 template class basic_value<wchar_t>;
+template class basic_shape_table<char>;
+template class basic_shape_table<wchar_t>;
 template UXS_EXPORT bool operator==(const basic_value<char>&, const basic_value<char>&) noexcept;
 template UXS_EXPORT bool operator==(const basic_value<wchar_t>&, const basic_value<wchar_t>&) noexcept;
 }  // namespace db
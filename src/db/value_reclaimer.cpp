@@ -0,0 +1,8 @@
+#include "uxs/impl/db/value_reclaimer_impl.h"
+
+namespace uxs {
+namespace db {
+template class basic_value_reclaimer<char>;
+template class basic_value_reclaimer<wchar_t>;
+}  // namespace db
+}  // namespace uxs
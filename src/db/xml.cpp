@@ -12,12 +12,106 @@ namespace uxs {
 namespace db {
 namespace xml {
 
-parser::parser(ibuf& in) : lexer_(in), name_cache_(16), token_{token_t::none, {}} {}
+std::pair<attributes_t::const_iterator, bool> attributes_t::emplace(std::string_view key, std::string_view value) {
+    auto it = find(key);
+    if (it != end()) { return {it, false}; }
+    const std::size_t offset = chars_.size();
+    const std::size_t count = key.size() + value.size();
+    std::vector<char> old_chars;  // arguments may refer to the old buffer, so it is released after copying them
+    if (count > chars_.capacity() - offset) {
+        old_chars.reserve(std::max(offset + count, 2 * chars_.capacity()));
+        old_chars.assign(chars_.begin(), chars_.end());
+        for (auto& item : items_) {
+            item.first = std::string_view(old_chars.data() + (item.first.data() - chars_.data()), item.first.size());
+            item.second = std::string_view(old_chars.data() + (item.second.data() - chars_.data()),
+                                           item.second.size());
+        }
+        chars_.swap(old_chars);
+    }
+    chars_.resize(offset + count);
+    std::copy_n(key.data(), key.size(), chars_.data() + offset);
+    std::copy_n(value.data(), value.size(), chars_.data() + offset + key.size());
+    items_.emplace_back(std::string_view(chars_.data() + offset, key.size()),
+                        std::string_view(chars_.data() + offset + key.size(), value.size()));
+    return {end() - 1, true};
+}
+
+void attributes_t::assign(const attributes_t& other) {
+    clear();
+    chars_.reserve(other.chars_.size());
+    items_.reserve(other.items_.size());
+    for (const auto& item : other) { emplace(item.first, item.second); }
+}
+
+std::string_view detail::name_table::intern(std::string_view name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) { return *it; }
+    names_.emplace_front(name);
+    ++size_;
+    return *index_.emplace(names_.front()).first;
+}
+
+path_filter::path_filter(std::initializer_list<std::string_view> paths) {
+    for (const auto& path : paths) { add(path); }
+}
+
+void path_filter::add(std::string_view path) {
+    if (path.empty() || path[0] != '/') { throw database_error("invalid path"); }
+    std::size_t node = 0;
+    for (std::size_t pos = 1;;) {
+        const std::size_t pos_end = std::min(path.find('/', pos), path.size());
+        const std::string_view step = path.substr(pos, pos_end - pos);
+        if (step.empty()) { throw database_error("invalid path"); }
+        const auto& children = nodes_[node].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [this, step](std::size_t child) { return nodes_[child].name == step; });
+        if (it != children.end()) {
+            node = *it;
+        } else {
+            nodes_.push_back(node_t{std::string(step), {}, false});
+            nodes_[node].children.push_back(nodes_.size() - 1);
+            node = nodes_.size() - 1;
+        }
+        if (pos_end == path.size()) { break; }
+        pos = pos_end + 1;
+    }
+    nodes_[node].is_selected = true;
+}
+
+detail::path_matcher::path_matcher(const path_filter& filter, name_table& names) : filter_(filter) {
+    names_.reserve(filter.nodes_.size());
+    for (const auto& node : filter.nodes_) {
+        names_.push_back(node.name != string_literal<char, '*'>{}() ? names.intern(node.name) : std::string_view());
+    }
+    active_.push_back(0);
+    levels_.push_back(0);
+}
+
+detail::path_match detail::path_matcher::enter(std::string_view name) {
+    const std::size_t first = levels_.back(), last = active_.size();
+    bool is_selected = false;
+    for (std::size_t n = first; n != last; ++n) {
+        for (const std::size_t child : filter_.nodes_[active_[n]].children) {
+            if (!names_[child].data() || names_[child].data() == name.data()) {
+                is_selected = is_selected || filter_.nodes_[child].is_selected;
+                active_.push_back(child);
+            }
+        }
+    }
+    if (is_selected || active_.size() == last) {
+        active_.resize(last);
+        return is_selected ? path_match::full : path_match::none;
+    }
+    levels_.push_back(last);
+    return path_match::partial;
+}
+
+parser::parser(ibuf& in) : lexer_(in), token_{token_t::none, {}} {}
 
 std::pair<token_t, std::string_view> parser::next_impl() {
     if (is_end_element_pending_) {
         is_end_element_pending_ = false;
-        return {token_t::end_element, name_cache_.front()};
+        return {token_t::end_element, name_};
     }
 
     while (lexer_.in.peek() != ibuf::traits_type::eof()) {
@@ -25,40 +119,31 @@ std::pair<token_t, std::string_view> parser::next_impl() {
 
         switch (*lexer_.in.curr()) {
             case '<': {  // found '<'
-                auto name_cache_it = name_cache_.begin();
-                auto name_cache_prev_it = name_cache_it;
-
                 attrs_.clear();
 
-                const auto read_attribute = [this, &name_cache_it, &name_cache_prev_it](std::string_view lval) {
-                    if (name_cache_it != name_cache_.end()) {
-                        name_cache_it->assign(lval.data(), lval.size());
-                    } else {
-                        name_cache_it = name_cache_.emplace_after(name_cache_prev_it, lval);
-                    }
+                const auto read_attribute = [this](std::string_view lval) {
+                    attr_name_.assign(lval.data(), lval.size());
                     if (lexer_.lex(lval) != detail::lex_token_t::eq) {
                         throw database_error(to_string(lexer_.ln) + ": expected `=`");
                     }
                     if (lexer_.lex(lval) != detail::lex_token_t::string) {
                         throw database_error(to_string(lexer_.ln) + ": expected valid attribute value");
                     }
-                    name_cache_prev_it = name_cache_it;
-                    attrs_.emplace(*name_cache_it++, lval);
+                    attrs_.emplace(attr_name_, lval);
                 };
 
                 switch (lexer_.lex(lval)) {
                     case detail::lex_token_t::start_element_open: {  // <name n1=v1 n2=v2...> or <name n1=v1 n2=v2.../>
-                        name_cache_it->assign(lval.data(), lval.size());
-                        ++name_cache_it;
+                        name_ = intern_name(lval);
                         while (true) {
                             auto tt = lexer_.lex(lval);
                             if (tt == detail::lex_token_t::name) {
                                 read_attribute(lval);
                             } else if (tt == detail::lex_token_t::close) {
-                                return {token_t::start_element, name_cache_.front()};
+                                return {token_t::start_element, name_};
                             } else if (tt == detail::lex_token_t::end_element_close) {
                                 is_end_element_pending_ = true;
-                                return {token_t::start_element, name_cache_.front()};
+                                return {token_t::start_element, name_};
                             } else {
                                 throw database_error(to_string(lexer_.ln) + ": expected name, `>` or `/>`");
                             }
@@ -69,21 +154,20 @@ std::pair<token_t, std::string_view> parser::next_impl() {
                         if (lexer_.lex(lval) != detail::lex_token_t::close) {
                             throw database_error(to_string(lexer_.ln) + ": expected `>`");
                         }
-                        return {token_t::end_element, lval};
+                        return {token_t::end_element, names_.find(lval)};
                     } break;
 
                     case detail::lex_token_t::pi_open: {  // <?xml n1=v1 n2=v2...?>
                         if (compare_strings_nocase(lval, string_literal<char, 'x', 'm', 'l'>{}()) != 0) {
                             throw database_error(to_string(lexer_.ln) + ": invalid document declaration");
                         }
-                        name_cache_it->assign(lval.data(), lval.size());
-                        ++name_cache_it;
+                        name_ = intern_name(lval);
                         while (true) {
                             auto tt = lexer_.lex(lval);
                             if (tt == detail::lex_token_t::name) {
                                 read_attribute(lval);
                             } else if (tt == detail::lex_token_t::pi_close) {
-                                return {token_t::preamble, name_cache_.front()};
+                                return {token_t::preamble, name_};
                             } else {
                                 throw database_error(to_string(lexer_.ln) + ": expected name or `?>`");
                             }
@@ -115,12 +199,7 @@ std::pair<token_t, std::string_view> parser::next_impl() {
 
             default: {
                 const char* curr0 = lexer_.in.curr();
-                const char* curr = std::find_if(curr0, lexer_.in.last(), [this](std::uint8_t ch) {
-                    using tbl = uxs::detail::char_tbl_t;
-                    if (ch != '\n') { return !!(tbl{}.flags()[ch] & tbl::is_xml_special); }
-                    ++lexer_.ln;
-                    return false;
-                });
+                const char* curr = db::detail::find_xml_special(curr0, lexer_.in.last(), lexer_.ln);
                 lexer_.in.setpos(curr - lexer_.in.first());
                 return {token_t::plain_text, to_string_view(curr0, curr)};
             } break;
@@ -130,6 +209,27 @@ std::pair<token_t, std::string_view> parser::next_impl() {
     return {token_t::eof, {}};
 }
 
+void parser::skip_element() {
+    assert(token_.first == token_t::start_element);
+    skipped_names_.clear();
+    skipped_names_.push_back(name_, is_name_interned());
+    while (!skipped_names_.empty()) {
+        switch (next()) {
+            case token_t::eof: throw database_error(to_string(lexer_.ln) + ": unexpected end of file");
+            case token_t::preamble: throw database_error(to_string(lexer_.ln) + ": unexpected document preamble");
+            case token_t::start_element: skipped_names_.push_back(name_, is_name_interned()); break;
+            case token_t::end_element: {
+                if (!skipped_names_.is_back(name())) {
+                    throw database_error(to_string(lexer_.ln) + ": unterminated element " +
+                                         std::string(skipped_names_.back()));
+                }
+                skipped_names_.pop_back();
+            } break;
+            default: break;
+        }
+    }
+}
+
 /*static*/ value_class parser::classify_value(const std::string_view& sval) {
     int state = lex_detail::sc_value;
     for (const std::uint8_t ch : sval) {
@@ -181,11 +281,7 @@ detail::lex_token_t detail::lexer::lex(std::string_view& lval) {
             const char* curr = in.curr();
             if (tbl{}.flags()[static_cast<std::uint8_t>(*curr)] & tbl::is_json_ws) {  // skip whitespaces
                 if (*curr == '\n') { ++ln; }
-                curr = std::find_if(curr + 1, in.last(), [this](std::uint8_t ch) {
-                    if (ch != '\n') { return !(tbl{}.flags()[ch] & tbl::is_json_ws); }
-                    ++ln;
-                    return false;
-                });
+                curr = db::detail::skip_json_ws(curr + 1, in.last(), ln);
                 in.setpos(curr - in.first());
                 if (!in.avail()) { continue; }
             }
@@ -201,11 +297,8 @@ detail::lex_token_t detail::lexer::lex(std::string_view& lval) {
                 continue;
             }
         } else {  // read string
-            const char other_quot = (current_string_quot == '\"' ? '\'' : '\"');
             const char* curr0 = in.curr();
-            const char* curr = std::find_if(curr0, in.last(), [other_quot](std::uint8_t ch) {
-                return !!(tbl{}.flags()[ch] & tbl::is_xml_string_special) && ch != other_quot;
-            });
+            const char* curr = db::detail::find_xml_string_special(curr0, in.last(), current_string_quot);
 
             in.setpos(curr - in.first());
             if (!in.avail()) {
@@ -392,10 +485,15 @@ detail::lex_token_t detail::lexer::lex(std::string_view& lval) {
 
 template UXS_EXPORT basic_value<char> parser::read(std::string_view, const std::allocator<char>&);
 template UXS_EXPORT basic_value<wchar_t> parser::read(std::string_view, const std::allocator<wchar_t>&);
+template UXS_EXPORT basic_value<char> parser::read(const path_filter&, const std::allocator<char>&);
+template UXS_EXPORT basic_value<wchar_t> parser::read(const path_filter&, const std::allocator<wchar_t>&);
 template UXS_EXPORT void write(membuffer& out, const basic_value<char>&, std::string_view, xml_fmt_opts, unsigned);
 template UXS_EXPORT void write(membuffer& out, const basic_value<wchar_t>&, std::wstring_view, xml_fmt_opts, unsigned);
 template UXS_EXPORT void write(wmembuffer& out, const basic_value<char>&, std::string_view, xml_fmt_opts, unsigned);
 template UXS_EXPORT void write(wmembuffer& out, const basic_value<wchar_t>&, std::wstring_view, xml_fmt_opts, unsigned);
+
+template class basic_writer<char>;
+template class basic_writer<wchar_t>;
 }  // namespace xml
 }  // namespace db
 }  // namespace uxs
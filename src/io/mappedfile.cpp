@@ -0,0 +1,36 @@
+#include "uxs/io/mappedfile.h"
+
+#include <cstring>
+
+using namespace uxs;
+
+int mappedfile::read(void* data, std::size_t sz, std::size_t& n_read) {
+    const std::size_t sz0 = sz;
+    while (sz) {
+        std::size_t mapped_sz = 0;
+        const void* p = map(mapped_sz, false);
+        if (!p) {
+            if (pos_ < size_ && sz == sz0) { return -1; }  // mapping failed, it is not the end of file
+            break;
+        }
+        if (sz < mapped_sz) { mapped_sz = sz; }
+        std::memcpy(data, p, mapped_sz);
+        pos_ += mapped_sz;
+        data = static_cast<std::uint8_t*>(data) + mapped_sz, sz -= mapped_sz;
+    }
+    n_read = sz0 - sz;
+    return 0;
+}
+
+std::int64_t mappedfile::seek(std::int64_t off, seekdir dir) {
+    if (!valid()) { return -1; }
+    std::int64_t pos = off;
+    switch (dir) {
+        case seekdir::curr: pos += static_cast<std::int64_t>(pos_); break;
+        case seekdir::end: pos += static_cast<std::int64_t>(size_); break;
+        default: break;
+    }
+    if (pos < 0) { return -1; }
+    pos_ = static_cast<std::uint64_t>(pos);
+    return pos;
+}